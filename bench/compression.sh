@@ -0,0 +1,100 @@
+#!/bin/bash
+# Mede o efeito da compressão por tópico: um feed publica N mensagens num tópico com outro
+# subscritor além dele, com texto repetitivo e com dados aleatórios (base64), com a compressão
+# desligada e ligada. Mostra os bytes entregues nos pipes dos subscritores (corpos das
+# tramas), o tempo gasto a comprimir, o tempo de CPU do manager e do subscritor (em
+# tiques do relógio, por isso com resolução de 1000/CLK_TCK ms) e o tempo total.
+#
+# Uso: bench/compression.sh [mensagens] [tamanho]   (por omissão 2000 mensagens de 3000 bytes)
+# Correr a partir da raiz do repositório, depois de make.
+
+COUNT=${1:-2000}
+SIZE=${2:-3000}
+WORK=$(mktemp -d /tmp/bench_compression.XXXXXX)
+TICKS=$(getconf CLK_TCK)
+
+cleanup() {
+    exec 3>&- 4>&- 2>/dev/null
+    kill $MANAGER_PID $SUB_PID 2>/dev/null
+    wait 2>/dev/null
+    rm -rf "$WORK" /tmp/manager_pipe /tmp/feed_pipe_bench_pub /tmp/feed_pipe_bench_sub
+}
+trap cleanup EXIT
+
+if [ ! -x ./manager ] || [ ! -x ./feed ]; then
+    echo "Compile primeiro com make." >&2
+    exit 1
+fi
+
+# Tempo de CPU (ms) de um processo, somando utilizador e sistema
+cpu_ms() {
+    awk -v ticks="$TICKS" '{ sub(/.*\) /, ""); print int(($12 + $13) * 1000 / ticks) }' /proc/$1/stat
+}
+
+# Cargas: texto com muitas repetições e dados aleatórios, uma linha "msg" por mensagem
+yes 'cotacao EURUSD bid 1.0841 ask 1.0843 volume 1000000 mercado aberto sessao europeia; ' |
+    tr -d '\n' | fold -w "$SIZE" | head -n "$COUNT" | sed 's/^/msg bench 0 /' > "$WORK/texto"
+head -c $((COUNT * SIZE * 3 / 4)) /dev/urandom | base64 -w "$SIZE" | head -n "$COUNT" |
+    sed 's/^/msg bench 0 /' > "$WORK/aleatorio"
+
+run() {
+    local payload=$1 compress=$2
+
+    rm -f /tmp/manager_pipe "$WORK"/msgs.txt*
+    mkfifo "$WORK/admin" "$WORK/sub"
+    MSG_FICH="$WORK/msgs.txt" MANAGER_SPIN_US=0 stdbuf -oL ./manager < "$WORK/admin" > "$WORK/manager.out" 2>&1 &
+    MANAGER_PID=$!
+    exec 3> "$WORK/admin"
+    while [ ! -p /tmp/manager_pipe ]; do sleep 0.05; done
+
+    ./feed bench_sub --raw < "$WORK/sub" > /dev/null 2> "$WORK/sub.out" &
+    SUB_PID=$!
+    exec 4> "$WORK/sub"
+    echo "subscribe bench" >&4
+    sleep 0.3
+    echo "compress bench $compress" >&3
+    sleep 0.2
+
+    local manager_cpu=$(cpu_ms $MANAGER_PID) sub_cpu=$(cpu_ms $SUB_PID)
+    local start=$(date +%s%N)
+    # O emissor tem de estar subscrito para publicar, por isso também recebe as mensagens
+    # Envio em rajadas de 50 mensagens, para não encher a fila de entrada (descarte por sobrecarga)
+    (echo "subscribe bench"; sleep 0.2; awk '{ print; if (NR % 50 == 0) { fflush(); system("sleep 0.01") } }' "$WORK/$payload"
+     echo exit) | ./feed bench_pub --raw > /dev/null 2>&1
+
+    # Esperar que o subscritor deixe de receber
+    local last=-1 now
+    while now=$(cpu_ms $SUB_PID) && [ "$now" != "$last" ]; do
+        last=$now
+        sleep 0.3
+    done
+    local elapsed=$(( ($(date +%s%N) - start) / 1000000 ))
+    manager_cpu=$(( $(cpu_ms $MANAGER_PID) - manager_cpu ))
+    sub_cpu=$(( $(cpu_ms $SUB_PID) - sub_cpu ))
+
+    echo "topics" >&3
+    echo "limits" >&3
+    sleep 0.3
+    local bytes=$(grep -o 'Bytes entregues: [0-9]*' "$WORK/manager.out" | tail -1 | grep -o '[0-9]*$')
+    local raw=$(grep -o 'sem compressão: [0-9]*' "$WORK/manager.out" | tail -1 | grep -o '[0-9]*$')
+    local codec=$(grep -o 'CPU de compressão: [0-9]*' "$WORK/manager.out" | tail -1 | grep -o '[0-9]*$')
+    local shed=$(grep -o '[0-9]* mensagens descartadas' "$WORK/manager.out" | tail -1 | grep -o '^[0-9]*')
+
+    echo "exit" >&4
+    echo "close" >&3
+    exec 3>&- 4>&-
+    wait $MANAGER_PID $SUB_PID 2>/dev/null
+    rm -f "$WORK/admin" "$WORK/sub"
+
+    printf "%-10s %-4s %12s %12s %8s %14s %12s %10s %12s\n" "$payload" "$compress" "${bytes:-0}" \
+           "${raw:-${bytes:-0}}" "${codec:--}" "$manager_cpu" "$sub_cpu" "$elapsed" "${shed:-0}"
+}
+
+printf "%d mensagens de %d bytes\n" "$COUNT" "$SIZE"
+printf "%-10s %-4s %12s %12s %8s %14s %12s %10s %12s\n" "carga" "lz" "bytes pipe" "sem lz" "lz us" \
+       "CPU manager ms" "CPU sub ms" "tempo ms" "descartadas"
+for payload in texto aleatorio; do
+    for compress in off on; do
+        run $payload $compress
+    done
+done
@@ -0,0 +1,96 @@
+// Microbenchmark da descodificação do protocolo: protocol_decode_action (campo action das
+// tramas) e protocol_parse_command (comandos do administrador), comparados com uma procura
+// linear na mesma tabela X-macro, como a que o índice veio substituir.
+//
+// Uso: bench/protocol [iterações]   (por omissão 20 milhões)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "protocol.h"
+
+typedef struct {
+    const char *word;
+    size_t len;
+    int domain;
+    Opcode opcode;
+} ScanVerb;
+
+#define WIRE_VERB(op, word) {word, sizeof(word) - 1, DOM_WIRE, op},
+#define COMMAND_VERB(op, word, domain, usage) {word, sizeof(word) - 1, domain, op},
+static const ScanVerb scan_verbs[] = {
+    PROTOCOL_WIRE(WIRE_VERB)
+    PROTOCOL_COMMANDS(COMMAND_VERB)
+};
+#undef WIRE_VERB
+#undef COMMAND_VERB
+
+// Procura linear de referência
+static Opcode scan_lookup(const char *word, size_t len, int domain) {
+    for (size_t i = 0; i < sizeof(scan_verbs) / sizeof(scan_verbs[0]); i++) {
+        const ScanVerb *verb = &scan_verbs[i];
+        if (verb->len == len && (verb->domain & domain) && memcmp(verb->word, word, len) == 0) {
+            return verb->opcode;
+        }
+    }
+    return OP_UNKNOWN;
+}
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int main(int argc, char *argv[]) {
+    long iterations = argc > 1 ? atol(argv[1]) : 20000000;
+
+    // Ações de todas as tramas, mais uma desconhecida
+    static const char *actions[] = {"INIT", "EXIT", "MSG", "SUB", "UNSUB", "ACK", "ERROR", "BOGUS"};
+    char frames[8][ACTION_LEN];
+    for (int i = 0; i < 8; i++) {
+        memset(frames[i], 0, ACTION_LEN);
+        strncpy(frames[i], actions[i], ACTION_LEN - 1);
+    }
+    static const char *commands[] = {"users", "topics", "latency t", "threads", "limits", "close", "show t", "nope"};
+
+    volatile int sink = 0;
+    ParsedCommand cmd;
+    long long start;
+    double decode_ns, scan_decode_ns, parse_ns, scan_parse_ns;
+
+    start = now_ns();
+    for (long i = 0; i < iterations; i++) {
+        sink += protocol_decode_action(frames[i & 7]);
+    }
+    decode_ns = (double)(now_ns() - start) / iterations;
+
+    start = now_ns();
+    for (long i = 0; i < iterations; i++) {
+        const char *action = frames[i & 7];
+        const char *end = memchr(action, '\0', ACTION_LEN);
+        sink += scan_lookup(action, end ? (size_t)(end - action) : ACTION_LEN, DOM_WIRE);
+    }
+    scan_decode_ns = (double)(now_ns() - start) / iterations;
+
+    start = now_ns();
+    for (long i = 0; i < iterations; i++) {
+        protocol_parse_command(commands[i & 7], DOM_ADMIN, &cmd);
+        sink += cmd.opcode;
+    }
+    parse_ns = (double)(now_ns() - start) / iterations;
+
+    start = now_ns();
+    for (long i = 0; i < iterations; i++) {
+        const char *line = commands[i & 7];
+        sink += scan_lookup(line, strcspn(line, " \t"), DOM_ADMIN);
+    }
+    scan_parse_ns = (double)(now_ns() - start) / iterations;
+
+    printf("%ld iterações por caso\n", iterations);
+    printf("%-32s %10s %10s\n", "", "índice ns", "linear ns");
+    printf("%-32s %10.1f %10.1f\n", "ação das tramas (decode_action)", decode_ns, scan_decode_ns);
+    printf("%-32s %10.1f %10.1f\n", "comandos admin (parse_command)", parse_ns, scan_parse_ns);
+    return sink == -1;
+}
@@ -0,0 +1,133 @@
+#include <string.h>
+#include "codec.h"
+
+#define CODEC_MIN_MATCH 4
+#define CODEC_HASH_BITS 12
+#define CODEC_MAX_OFFSET 65535
+
+static unsigned int codec_hash(const unsigned char *p) {
+    unsigned int v;
+    memcpy(&v, p, sizeof(v));
+    return (v * 2654435761u) >> (32 - CODEC_HASH_BITS);
+}
+
+// Escreve um comprimento estendido (sequência de 255 terminada por um byte < 255)
+static int codec_put_length(unsigned char **op, const unsigned char *oend, int len) {
+    while (len >= 255) {
+        if (*op >= oend) return -1;
+        *(*op)++ = 255;
+        len -= 255;
+    }
+    if (*op >= oend) return -1;
+    *(*op)++ = (unsigned char)len;
+    return 0;
+}
+
+static int codec_emit(unsigned char **op, const unsigned char *oend,
+                      const unsigned char *literals, int lit_len, int offset, int match_len) {
+    unsigned char *token = (*op)++;
+    if (token >= oend) return -1;
+
+    int match_code = match_len ? match_len - CODEC_MIN_MATCH : 0;
+    *token = (unsigned char)(((lit_len < 15 ? lit_len : 15) << 4) | (match_code < 15 ? match_code : 15));
+
+    if (lit_len >= 15 && codec_put_length(op, oend, lit_len - 15) != 0) return -1;
+    if (*op + lit_len > oend) return -1;
+    memcpy(*op, literals, lit_len);
+    *op += lit_len;
+
+    if (match_len == 0) return 0; // Última sequência: só literais
+
+    if (*op + 2 > oend) return -1;
+    *(*op)++ = (unsigned char)(offset & 0xff);
+    *(*op)++ = (unsigned char)(offset >> 8);
+
+    if (match_code >= 15 && codec_put_length(op, oend, match_code - 15) != 0) return -1;
+    return 0;
+}
+
+int codec_compress(const unsigned char *in, int in_len, unsigned char *out, int out_cap) {
+    int table[1 << CODEC_HASH_BITS];
+    const unsigned char *ip = in;
+    const unsigned char *anchor = in;
+    const unsigned char *iend = in + in_len;
+    const unsigned char *mflimit = iend - CODEC_MIN_MATCH;
+    unsigned char *op = out;
+    const unsigned char *oend = out + out_cap;
+
+    memset(table, -1, sizeof(table));
+
+    while (ip < mflimit) {
+        unsigned int h = codec_hash(ip);
+        int candidate = table[h];
+        table[h] = (int)(ip - in);
+
+        if (candidate < 0 || ip - (in + candidate) > CODEC_MAX_OFFSET ||
+            memcmp(in + candidate, ip, CODEC_MIN_MATCH) != 0) {
+            ip++;
+            continue;
+        }
+
+        const unsigned char *match = in + candidate;
+        int len = CODEC_MIN_MATCH;
+        while (ip + len < iend && match[len] == ip[len]) {
+            len++;
+        }
+
+        if (codec_emit(&op, oend, anchor, (int)(ip - anchor), (int)(ip - match), len) != 0) return -1;
+        ip += len;
+        anchor = ip;
+    }
+
+    if (codec_emit(&op, oend, anchor, (int)(iend - anchor), 0, 0) != 0) return -1;
+    return (int)(op - out);
+}
+
+static int codec_get_length(const unsigned char **ip, const unsigned char *iend, int *len) {
+    unsigned char b;
+    do {
+        if (*ip >= iend) return -1;
+        b = *(*ip)++;
+        *len += b;
+    } while (b == 255);
+    return 0;
+}
+
+int codec_decompress(const unsigned char *in, int in_len, unsigned char *out, int out_cap) {
+    const unsigned char *ip = in;
+    const unsigned char *iend = in + in_len;
+    unsigned char *op = out;
+    unsigned char *oend = out + out_cap;
+
+    while (ip < iend) {
+        unsigned char token = *ip++;
+
+        int lit_len = token >> 4;
+        if (lit_len == 15 && codec_get_length(&ip, iend, &lit_len) != 0) return -1;
+        if (ip + lit_len > iend || op + lit_len > oend) return -1;
+        memcpy(op, ip, lit_len);
+        ip += lit_len;
+        op += lit_len;
+
+        if (ip == iend) break; // Última sequência
+
+        if (ip + 2 > iend) return -1;
+        int offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op - out) return -1;
+
+        int match_len = token & 0x0f;
+        if (match_len == 15 && codec_get_length(&ip, iend, &match_len) != 0) return -1;
+        match_len += CODEC_MIN_MATCH;
+        if (op + match_len > oend) return -1;
+
+        // Cópia byte a byte: a origem pode sobrepor-se ao destino
+        const unsigned char *match = op - offset;
+        for (int i = 0; i < match_len; i++) {
+            op[i] = match[i];
+        }
+        op += match_len;
+    }
+
+    return (int)(op - out);
+}
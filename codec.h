@@ -0,0 +1,17 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+// Modos de compressão por tópico
+#define COMPRESS_NONE 0
+#define COMPRESS_LZ   1
+
+#define COMPRESS_MIN_BODY 64 // Corpos mais pequenos não compensam a compressão
+
+// Compressão LZ77 com formato de blocos ao estilo LZ4 (token, literais, offset, match).
+// Devolve o tamanho comprimido, ou -1 se o resultado não couber em out_cap.
+int codec_compress(const unsigned char *in, int in_len, unsigned char *out, int out_cap);
+
+// Devolve o tamanho descomprimido, ou -1 se os dados forem inválidos ou não couberem em out_cap.
+int codec_decompress(const unsigned char *in, int in_len, unsigned char *out, int out_cap);
+
+#endif
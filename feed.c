@@ -1,233 +1,379 @@
-#include "feed.h"
-
-void cleanup_and_exit(int manager_fd, int client_fd, const char *client_pipe_name, ThreadData *thread_data) {
-    printf("\nA Encerrar...\n");
-
-    // Sinalizar para a thread encerrar
-    if (thread_data) {
-        thread_data->running = 0;
-    }
-
-    // Fechar os pipes
-    if (manager_fd != -1) {
-        close(manager_fd);
-    }
-    if (client_fd != -1) {
-        close(client_fd);
-    }
-
-    // Remover o named pipe exclusivo
-    if (client_pipe_name) {
-        unlink(client_pipe_name);
-    }
-
-    printf("Recursos libertados. A terminar...\n");
-    exit(EXIT_SUCCESS);
-}
-
-void sigint_handler(int signo) {
-    extern int global_manager_fd;
-    extern int global_client_fd;
-    extern char global_client_pipe_name[100];
-    extern ThreadData global_thread_data;
-
-    cleanup_and_exit(global_manager_fd, global_client_fd, global_client_pipe_name, &global_thread_data);
-}
-
-
-
-// Função que envia mensagens ao manager
-void send_command_to_manager(int manager_fd, const Message *msg) {
-    if (write(manager_fd, msg, sizeof(Message)) == -1) {
-        perror("Erro ao enviar comando ao manager");
-    }
-}
-
-// Thread que escuta respostas do manager
-void *listen_manager(void *arg) {
-    ThreadData *data = (ThreadData *)arg;
-    Message msg;
-
-    while (data->running) {
-        ssize_t bytes_read = read(data->client_fd, &msg, sizeof(Message));
-        if (bytes_read > 0) {
-
-            if(strcmp(msg.action, "EXIT") == 0){
-                printf("Comando de encerramento recebido do manager. A terminar...\n");
-                data->running = 0;
-                break;
-            }
-
-            printf("\n[Mensagem Recebida]\n");
-            printf("Tópico: %s\n", msg.topic);
-            printf("De: %s\n", msg.username);
-            printf("Conteúdo: %s\n", msg.body);
-            printf("> ");
-            fflush(stdout);
-        } else if (bytes_read == 0) {
-            // Pipe foi fechado pelo manager
-            
-            data->running = 0;
-            break;
-        } else {
-            perror("Erro ao ler do pipe do manager");
-            break;
-        }
-    }
-
-    return NULL;
-}
-
-int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Uso: %s <username>\n", argv[0]);
-        return EXIT_FAILURE;
-    }
-
-    signal(SIGINT, sigint_handler); // Configurar manipulador de sinal
-
-    // Variáveis para gerenciar recursos
-    char *username = argv[1];
-    global_manager_fd = -1;
-    global_client_fd = -1;
-    snprintf(global_client_pipe_name, sizeof(global_client_pipe_name), "%s%s", CLIENT_PIPE_BASE, username);
-
-
-    int manager_fd, client_fd;
-    char client_pipe_name[100];
-    ThreadData thread_data;
-
-    // Criar um named pipe exclusivo para o feed
-    snprintf(client_pipe_name, sizeof(client_pipe_name), "%s%s", CLIENT_PIPE_BASE, username);
-    if (mkfifo(client_pipe_name, 0666) == -1) {
-        perror("Erro ao criar pipe exclusivo do feed");
-        return EXIT_FAILURE;
-    }
-
-    // Abrir o pipe do manager para envio de comandos
-    manager_fd = open(MANAGER_PIPE, O_WRONLY);
-    if (manager_fd == -1) {
-        perror("Erro ao abrir pipe do manager");
-        unlink(client_pipe_name);
-        return EXIT_FAILURE;
-    }
-
-    // Enviar informações iniciais ao manager (username e nome do pipe)
-    Message init_msg = {0};
-    strncpy(init_msg.action, "INIT", ACTION_LEN);
-    strncpy(init_msg.username, username, sizeof(init_msg.username));
-    strncpy(init_msg.body, client_pipe_name, MAX_MSG_BODY);
-
-    send_command_to_manager(manager_fd, &init_msg);
-
-    // Aguardar confirmação do manager
-    printf("Aguardando confirmação do manager...\n");
-    client_fd = open(client_pipe_name, O_RDONLY);
-    if (client_fd == -1) {
-        perror("Erro ao abrir pipe exclusivo para leitura");
-        close(manager_fd);
-        unlink(client_pipe_name);
-        return EXIT_FAILURE;
-    }
-
-    printf("Conexão estabelecida com o manager!\n");
-
-    // Iniciar a thread para escutar respostas do manager
-    pthread_t listener_thread;
-    thread_data.client_fd = client_fd;
-    thread_data.running = 1;
-    if (pthread_create(&listener_thread, NULL, listen_manager, &thread_data) != 0) {
-        perror("Erro ao criar a thread");
-        close(manager_fd);
-        close(client_fd);
-        unlink(client_pipe_name);
-        return EXIT_FAILURE;
-    }
-
-    // Loop principal para comandos do utilizador
-    char command[100];
-    while (thread_data.running) {
-        printf("> ");
-        if (fgets(command, sizeof(command), stdin) == NULL) {
-            break;
-        }
-
-        // Remover newline do comando
-        command[strcspn(command, "\n")] = '\0';
-
-        if (strcmp(command, "exit") == 0) {
-            printf("A sair...\n");
-
-            // Enviar comando EXIT ao manager
-            Message exit_msg = {0};
-            strncpy(exit_msg.action, "EXIT", ACTION_LEN);
-            strncpy(exit_msg.username, username, sizeof(exit_msg.username));
-
-            send_command_to_manager(manager_fd, &exit_msg);
-            break;
-        } else if (strncmp(command, "msg ", 4) == 0) {
-            // Comando MSG
-            Message msg = {0};
-            char topic[MAX_TOPIC_NAME];
-            int duration;
-            char body[MAX_MSG_BODY];
-
-            if (sscanf(command + 4, "%s %d %[^\n]", topic, &duration, body) < 3) {
-                printf("Formato inválido. Uso: msg <topico> <duracao> <mensagem>\n");
-                continue;
-            }
-
-            strncpy(msg.action, "MSG", ACTION_LEN);
-            strncpy(msg.topic, topic, MAX_TOPIC_NAME);
-            strncpy(msg.username, username, sizeof(msg.username));
-            strncpy(msg.body, body, MAX_MSG_BODY);
-            msg.duration = duration;
-
-            send_command_to_manager(manager_fd, &msg);
-            printf("Mensagem enviada para o tópico '%s'.\n", topic);
-        } else if (strncmp(command, "subscribe ", 10) == 0) {
-            // Comando SUBSCRIBE
-            Message msg = {0};
-            char topic[MAX_TOPIC_NAME];
-
-            if (sscanf(command + 10, "%s", topic) != 1) {
-                printf("Formato inválido. Uso: subscribe <topico>\n");
-                continue;
-            }
-
-            strncpy(msg.action, "SUB", ACTION_LEN);
-            strncpy(msg.topic, topic, MAX_TOPIC_NAME);
-            strncpy(msg.username, username, sizeof(msg.username));
-
-            send_command_to_manager(manager_fd, &msg);
-            printf("Subscrito ao tópico '%s'.\n", topic);
-        } else if (strncmp(command, "unsubscribe ", 12) == 0) {
-            // Comando UNSUBSCRIBE
-            Message msg = {0};
-            char topic[MAX_TOPIC_NAME];
-
-            if (sscanf(command + 12, "%s", topic) != 1) {
-                printf("Formato inválido. Uso: unsubscribe <topico>\n");
-                continue;
-            }
-
-            strncpy(msg.action, "UNSUB", ACTION_LEN);
-            strncpy(msg.topic, topic, MAX_TOPIC_NAME);
-            strncpy(msg.username, username, sizeof(msg.username));
-
-            send_command_to_manager(manager_fd, &msg);
-            printf("Subscrição removida do tópico '%s'.\n", topic);
-        } else {
-            printf("Comando desconhecido: %s. Tente um dos seguintes: topics, msg, subscribe, unsubscribe, exit.\n", command);
-        }
-    }
-
-    // Encerrar a thread e limpar recursos
-    thread_data.running = 0;
-    pthread_join(listener_thread, NULL);
-    close(manager_fd);
-    close(client_fd);
-    unlink(client_pipe_name);
-
-    return EXIT_SUCCESS;
-}
+#include "feed.h"
+
+void sigint_handler(int signo) {
+    extern FeedState global_feed_state;
+
+    printf("\nA Encerrar...\n");
+
+    // Fecha os pipes e remove o pipe exclusivo do feed
+    feed_close(global_feed_state.client);
+
+    printf("Recursos libertados. A terminar...\n");
+    exit(EXIT_SUCCESS);
+}
+
+
+
+static const char *const trace_hop_names[TRACE_HOPS] = {
+    "feed -> manager",
+    "manager",
+    "manager -> feed",
+    "total",
+};
+
+long long monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Regista os troços de uma mensagem medida: envio -> saída da fila do manager ->
+// distribuição -> receção neste feed
+void record_trace(FeedState *state, const FeedMessage *msg) {
+    long long received = monotonic_ns();
+    long long hops[TRACE_HOPS] = {
+        msg->t_dequeue - msg->t_publish,
+        msg->t_fanout - msg->t_dequeue,
+        received - msg->t_fanout,
+        received - msg->t_publish,
+    };
+
+    for (int i = 0; i < TRACE_HOPS; i++) {
+        hist_record(&state->hops[i], hops[i]);
+    }
+}
+
+void print_trace(FeedState *state) {
+    char summary[256];
+
+    printf("Latência das mensagens recebidas com medição:\n");
+    for (int i = 0; i < TRACE_HOPS; i++) {
+        hist_format(&state->hops[i], summary, sizeof(summary));
+        printf("- %-16s %s\n", trace_hop_names[i], summary);
+    }
+}
+
+// Escreve de uma vez a saída acumulada do lote
+void out_flush(FeedState *state) {
+    // As respostas aos comandos vão pelo stdio: têm de sair antes, para manter a ordem
+    fflush(stdout);
+
+    int done = 0;
+    while (done < state->out_len) {
+        ssize_t n = write(state->out_fd, state->out_buf + done, state->out_len - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("Erro ao escrever a saída");
+            break;
+        }
+        done += n;
+    }
+    state->out_len = 0;
+}
+
+void out_append(FeedState *state, const void *data, int len) {
+    if (state->out_len + len > OUT_BUF_SIZE) {
+        out_flush(state);
+    }
+    if (len > OUT_BUF_SIZE) {
+        // Mensagem longa reconstruída: maior do que o buffer, segue diretamente
+        fflush(stdout);
+        for (int done = 0; done < len;) {
+            ssize_t n = write(state->out_fd, (const char *)data + done, len - done);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                perror("Erro ao escrever a saída");
+                break;
+            }
+            done += n;
+        }
+        return;
+    }
+    memcpy(state->out_buf + state->out_len, data, len);
+    state->out_len += len;
+}
+
+void out_printf(FeedState *state, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(state->out_buf + state->out_len, OUT_BUF_SIZE - state->out_len, fmt, args);
+    va_end(args);
+
+    if (len >= OUT_BUF_SIZE - state->out_len) {
+        // Não coube: esvaziar o buffer e formatar de novo no início
+        out_flush(state);
+        va_start(args, fmt);
+        len = vsnprintf(state->out_buf, OUT_BUF_SIZE, fmt, args);
+        va_end(args);
+        if (len >= OUT_BUF_SIZE) len = OUT_BUF_SIZE - 1;
+    }
+    state->out_len += len;
+}
+
+// Callback da libfeed: acrescenta à saída do lote o que houver a mostrar
+void show_message(FeedClient *client, const FeedMessage *msg, void *arg) {
+    FeedState *state = arg;
+
+    if (msg->flags & FRAME_TRACED) {
+        record_trace(state, msg);
+    }
+
+    // Modo --raw: a trama segue tal como chegou (já descomprimida), para outro processo a analisar
+    if (state->raw) {
+        if (msg->frame) {
+            out_append(state, msg->frame, msg->frame_len);
+        }
+        return;
+    }
+
+    if (msg->opcode == OP_ERROR) {
+        out_printf(state, "\n[Erro %s] %s\n", feed_error_name(msg->error), msg->body);
+        return;
+    }
+
+    out_printf(state, "\n[Mensagem Recebida]\nTópico: %s\nDe: %s\n", msg->topic, msg->username);
+    if (msg->body_len > MAX_MSG_BODY || msg->stream_total > 0) {
+        // Mensagem longa reconstruída pela libfeed
+        out_printf(state, "Conteúdo (%u bytes): ", msg->body_len);
+        out_append(state, msg->body, msg->body_len);
+        out_append(state, "\n", 1);
+    } else {
+        out_printf(state, "Conteúdo: %s\n", msg->body);
+    }
+}
+
+// Trata as mensagens que o manager enviou. A saída do lote inteiro é escrita de uma vez no fim.
+void read_manager(FeedState *state) {
+    if (feed_dispatch(state->client, show_message, state) < 0 || !feed_connected(state->client)) {
+        state->running = 0;
+    }
+
+    if (!state->raw && state->out_len > 0 && state->running) {
+        out_printf(state, "> ");
+    }
+    out_flush(state);
+
+    if (!state->running) {
+        printf("Comando de encerramento recebido do manager. A terminar...\n");
+    }
+}
+
+// Trata uma linha de comando do utilizador. Devolve 1 se o feed deve terminar.
+int handle_command(FeedState *state, char *command) {
+    ParsedCommand cmd;
+    if (protocol_parse_command(command, DOM_CLIENT, &cmd) != 0) {
+        printf("Comando desconhecido: %s. Tente um dos seguintes: %s.\n", command, protocol_command_list(DOM_CLIENT));
+        return 0;
+    }
+
+    if (cmd.opcode == OP_LATENCY) {
+        if (state->trace) {
+            print_trace(state);
+        } else {
+            printf("Medição de latência desligada. Inicie o feed com --trace.\n");
+        }
+        return 0;
+    }
+
+    if (cmd.opcode == OP_EXIT) {
+        printf("A sair...\n");
+        return 1; // O EXIT é enviado ao manager por feed_close
+    }
+
+    char topic[MAX_TOPIC_NAME];
+    if (cmd.opcode == OP_MSG || cmd.opcode == OP_URGENT) {
+        int duration;
+        char body[MAX_MSG_BODY + 2]; // Um byte a mais para detetar corpos demasiado longos
+        char format[32];
+
+        snprintf(format, sizeof(format), "%%19s %%d %%%d[^\n]", MAX_MSG_BODY + 1);
+        if (sscanf(cmd.args, format, topic, &duration, body) < 3) {
+            printf("Formato inválido. Uso: %s %s\n", cmd.verb, cmd.usage);
+            return 0;
+        }
+        if (strlen(body) > MAX_MSG_BODY) {
+            printf("Mensagem demasiado longa (máximo %d bytes). Use o comando file para textos maiores.\n", MAX_MSG_BODY);
+            return 0;
+        }
+
+        int priority = cmd.opcode == OP_URGENT ? QOS_URGENT : QOS_NORMAL;
+        if (feed_publish(state->client, topic, duration, priority, body, -1) == -1) {
+            perror("Erro ao enviar comando ao manager");
+        } else {
+            printf("Mensagem enviada para o tópico '%s'.\n", topic);
+        }
+    } else if (cmd.opcode == OP_FILE) {
+        char path[256];
+
+        if (sscanf(cmd.args, "%19s %255[^\n]", topic, path) != 2) {
+            printf("Formato inválido. Uso: %s %s\n", cmd.verb, cmd.usage);
+            return 0;
+        }
+
+        if (feed_publish_file(state->client, topic, path) == 0) {
+            printf("Envio de '%s' para o tópico '%s' iniciado.\n", path, topic);
+        } else if (errno == EFBIG) {
+            printf("Ficheiro demasiado grande (máximo %d bytes).\n", MAX_STREAM_LEN);
+        } else if (errno == EBUSY) {
+            printf("Demasiadas mensagens longas em envio.\n");
+        } else {
+            perror("Erro ao abrir ficheiro");
+        }
+    } else {
+        // Comandos SUBSCRIBE e UNSUBSCRIBE (o SUB pode levar um filtro)
+        char filter[MAX_FILTER_LEN] = "";
+        if (sscanf(cmd.args, "%19s %127[^\n]", topic, filter) < 1) {
+            printf("Formato inválido. Uso: %s %s\n", cmd.verb, cmd.usage);
+            return 0;
+        }
+
+        int result = cmd.opcode == OP_SUB ? feed_subscribe(state->client, topic, filter)
+                                          : feed_unsubscribe(state->client, topic);
+        if (result == -1) {
+            perror("Erro ao enviar comando ao manager");
+        } else if (cmd.opcode == OP_SUB && filter[0]) {
+            printf("Subscrito ao tópico '%s' com filtro: %s\n", topic, filter);
+        } else if (cmd.opcode == OP_SUB) {
+            printf("Subscrito ao tópico '%s'.\n", topic);
+        } else {
+            printf("Subscrição removida do tópico '%s'.\n", topic);
+        }
+    }
+    return 0;
+}
+
+// Lê os comandos disponíveis no stdin sem bloquear e trata cada linha completa
+void read_commands(FeedState *state) {
+    ssize_t n = read(STDIN_FILENO, state->line_buf + state->line_len, LINE_BUF_SIZE - 1 - state->line_len);
+    if (n < 0) {
+        if (errno != EAGAIN && errno != EINTR) {
+            perror("Erro ao ler comandos");
+            state->running = 0;
+        }
+        return;
+    }
+    if (n == 0) {
+        state->running = 0; // Fim do stdin
+        return;
+    }
+    state->line_len += n;
+
+    int start = 0;
+    for (int i = 0; i < state->line_len && state->running; i++) {
+        if (state->line_buf[i] != '\n') {
+            continue;
+        }
+        state->line_buf[i] = '\0';
+        if (state->discarding) {
+            state->discarding = 0; // Fim da linha demasiado longa
+        } else if (handle_command(state, state->line_buf + start)) {
+            state->running = 0;
+        }
+        start = i + 1;
+    }
+
+    // Linha demasiado longa sem fim: recusá-la inteira em vez de a executar aos bocados
+    if (start == 0 && state->line_len == LINE_BUF_SIZE - 1 && state->running) {
+        if (!state->discarding) {
+            printf("Linha demasiado longa (máximo %d bytes), ignorada. Use o comando file para textos maiores.\n",
+                   LINE_BUF_SIZE - 2);
+            state->discarding = 1;
+        }
+        start = state->line_len;
+    }
+
+    state->line_len -= start;
+    memmove(state->line_buf, state->line_buf + start, state->line_len);
+
+    if (state->running) {
+        printf("> ");
+    }
+    fflush(stdout);
+}
+
+// Ciclo de eventos: stdin e a ligação ao manager (pipe exclusivo e envio de blocos)
+void run_event_loop(FeedState *state) {
+    printf("> ");
+    fflush(stdout);
+
+    while (state->running) {
+        struct pollfd pfds[2] = {
+            {feed_fd(state->client), POLLIN, 0},
+            {STDIN_FILENO, POLLIN, 0},
+        };
+
+        // Com blocos por enviar não se dorme, a não ser que o pipe do manager esteja cheio
+        int timeout = feed_timeout(state->client);
+        if (poll(pfds, 2, timeout) == -1) {
+            if (errno == EINTR) continue;
+            perror("Erro no poll");
+            break;
+        }
+
+        if (pfds[0].revents || timeout >= 0) {
+            read_manager(state);
+        }
+        if (pfds[1].revents && state->running) {
+            read_commands(state);
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    FeedState *state = &global_feed_state;
+    int options = 0;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--trace") == 0) {
+            options |= FEED_TRACE;
+        } else if (strcmp(argv[i], "--raw") == 0) {
+            options |= FEED_CHUNKS; // Os blocos seguem tal como chegam
+        } else {
+            argc = 0;
+        }
+    }
+    if (argc < 2) {
+        fprintf(stderr, "Uso: %s <username> [--trace] [--raw]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    signal(SIGINT, sigint_handler); // Configurar manipulador de sinal
+
+    // Modo --raw: o stdout original recebe só as tramas, o resto do texto vai para o stderr
+    state->out_fd = STDOUT_FILENO;
+    state->raw = (options & FEED_CHUNKS) != 0;
+    state->trace = (options & FEED_TRACE) != 0;
+    if (state->raw) {
+        state->out_fd = dup(STDOUT_FILENO);
+        if (state->out_fd == -1 || dup2(STDERR_FILENO, STDOUT_FILENO) == -1) {
+            perror("Erro ao preparar a saída binária");
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Criar o pipe exclusivo, enviar o INIT e aguardar confirmação do manager
+    char reply[MAX_MSG_BODY + 1];
+    printf("Aguardando confirmação do manager...\n");
+    fflush(stdout);
+    state->client = feed_connect(argv[1], options, reply, sizeof(reply));
+    if (!state->client) {
+        fprintf(stderr, "%s\n", reply);
+        return EXIT_FAILURE;
+    }
+
+    // Sessão retomada: o manager indica quantas subscrições repôs
+    if (reply[0]) {
+        printf("%s\n", reply);
+    }
+    printf("Conexão estabelecida com o manager!\n");
+
+    state->running = 1;
+    run_event_loop(state);
+
+    if (state->trace) {
+        print_trace(state);
+    }
+    feed_close(state->client);
+    state->client = NULL;
+
+    return EXIT_SUCCESS;
+}
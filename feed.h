@@ -1,36 +1,37 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <unistd.h>
-#include <fcntl.h>
-#include <pthread.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <unistd.h>
-#include "signal.h"
-
-#define MAX_TOPIC_NAME 20
-#define MAX_MSG_BODY 300
-#define MANAGER_PIPE "/tmp/manager_pipe"   // Pipe principal para comunicação com o manager
-#define CLIENT_PIPE_BASE "/tmp/feed_pipe_" // Base para o pipe exclusivo do feed
-#define ACTION_LEN 10  // Tamanho máximo para as strings de ação
-
-// Estrutura para mensagens enviadas ao manager
-typedef struct {
-    char action[ACTION_LEN];       // Tipo de ação ("MSG", "SUB", "UNSUB", "EXIT", "INIT")
-    char topic[MAX_TOPIC_NAME];   // Nome do tópico
-    char username[50];            // Nome do utilizador
-    char body[MAX_MSG_BODY];      // Corpo da mensagem
-    int duration;                 // Duração (aplicável para mensagens persistentes)
-} Message;
-
-// Estrutura para dados compartilhados
-typedef struct {
-    int client_fd;  // Pipe exclusivo para receber respostas do manager
-    int running;    // Flag para encerrar a thread
-} ThreadData;
-
-int global_manager_fd = -1;
-int global_client_fd = -1;
-char global_client_pipe_name[100];
-ThreadData global_thread_data;
\ No newline at end of file
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <stdarg.h>
+#include "signal.h"
+#include "protocol.h"
+#include "filter.h"
+#include "hist.h"
+#include "libfeed.h"
+
+#define TRACE_HOPS 4         // Troços medidos com --trace (ver trace_hop_names)
+#define OUT_BUF_SIZE 65536                 // Saída de um lote de mensagens, escrita de uma só vez
+#define LINE_BUF_SIZE (MAX_MSG_BODY + 100) // Linha de comando lida do stdin
+
+// Estado do programa interativo. A ligação ao manager é gerida pela libfeed.
+typedef struct {
+    FeedClient *client;
+    int running;    // Flag para terminar o ciclo de eventos
+    int trace;      // Modo --trace: mensagens enviadas com FRAME_TRACED
+    int out_fd;     // Destino da saída dos lotes (com --raw, o stdout original)
+    int raw;        // Modo --raw: tramas recebidas escritas em binário, sem formatação
+    Histogram hops[TRACE_HOPS]; // Latência de cada troço das mensagens recebidas
+    char out_buf[OUT_BUF_SIZE];
+    int out_len;
+    char line_buf[LINE_BUF_SIZE]; // Comando do stdin ainda sem fim de linha
+    int line_len;
+    int discarding; // A ignorar o resto de uma linha demasiado longa
+} FeedState;
+
+FeedState global_feed_state;
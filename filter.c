@@ -0,0 +1,211 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "filter.h"
+
+// Índice do padrão no matcher (reutiliza padrões iguais). Devolve -1 se não houver espaço.
+static int matcher_add(Matcher *matcher, const char *pattern, int len) {
+    for (int i = 0; i < matcher->pattern_count; i++) {
+        if (matcher->pattern_len[i] == len && memcmp(matcher->patterns[i], pattern, len) == 0) {
+            return i;
+        }
+    }
+
+    if (matcher->pattern_count >= FILTER_MAX_PATTERNS) {
+        return -1;
+    }
+
+    int id = matcher->pattern_count++;
+    memcpy(matcher->patterns[id], pattern, len);
+    matcher->patterns[id][len] = '\0';
+    matcher->pattern_len[id] = (unsigned char)len;
+    return id;
+}
+
+int filter_compile(const char *text, Matcher *matcher, Filter *filter, char *error, int error_len) {
+    memset(filter, 0, sizeof(*filter));
+    filter->dur_min = INT_MIN;
+    filter->dur_max = INT_MAX;
+
+    char copy[MAX_FILTER_LEN];
+    strncpy(copy, text, sizeof(copy) - 1);
+    copy[sizeof(copy) - 1] = '\0';
+
+    int terms = 0;
+    char *saveptr;
+    for (char *term = strtok_r(copy, " \t", &saveptr); term; term = strtok_r(NULL, " \t", &saveptr)) {
+        if (++terms > FILTER_MAX_TERMS) {
+            snprintf(error, error_len, "no máximo %d termos", FILTER_MAX_TERMS);
+            return -1;
+        }
+
+        char *value;
+        if (strncmp(term, "de=", 3) == 0) {
+            strncpy(filter->from, term + 3, sizeof(filter->from) - 1);
+        } else if (strncmp(term, "dur", 3) == 0 && (term[3] == '>' || term[3] == '<' || term[3] == '=')) {
+            int n = (int)strtol(term + 4, &value, 10);
+            if (value == term + 4 || *value != '\0' || n < 0) {
+                snprintf(error, error_len, "duração inválida em '%s'", term);
+                return -1;
+            }
+            if (term[3] != '<') filter->dur_min = term[3] == '>' ? n + 1 : n;
+            if (term[3] != '>') filter->dur_max = term[3] == '<' ? n - 1 : n;
+        } else if ((value = strchr(term, '=')) != NULL &&
+                   (strncmp(term, "contem=", 7) == 0 || strncmp(term, "prefixo=", 8) == 0)) {
+            value++;
+            int len = (int)strlen(value);
+            if (len == 0 || len >= FILTER_PATTERN_LEN) {
+                snprintf(error, error_len, "texto de '%s' tem de ter entre 1 e %d caracteres", term, FILTER_PATTERN_LEN - 1);
+                return -1;
+            }
+
+            int id = matcher_add(matcher, value, len);
+            if (id < 0) {
+                snprintf(error, error_len, "limite de %d padrões no tópico atingido", FILTER_MAX_PATTERNS);
+                return -1;
+            }
+            if (term[0] == 'c') {
+                filter->contains |= 1ULL << id;
+            } else {
+                filter->prefix |= 1ULL << id;
+            }
+        } else {
+            snprintf(error, error_len, "termo desconhecido '%s' (de=, dur>, dur<, dur=, contem=, prefixo=)", term);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int filter_match(const Filter *filter, const char *username, int duration,
+                 unsigned long long found, unsigned long long at_start, int has_body) {
+    if (filter->from[0] && strcmp(filter->from, username) != 0) return 0;
+    if (duration < filter->dur_min || duration > filter->dur_max) return 0;
+
+    if (filter->contains | filter->prefix) {
+        if (!has_body) return 0;
+        if ((found & filter->contains) != filter->contains) return 0;
+        if ((at_start & filter->prefix) != filter->prefix) return 0;
+    }
+    return 1;
+}
+
+void matcher_reset(Matcher *matcher) {
+    free(matcher->next);
+    free(matcher->output);
+    memset(matcher, 0, sizeof(*matcher));
+}
+
+int matcher_build(Matcher *matcher) {
+    free(matcher->next);
+    free(matcher->output);
+    matcher->next = NULL;
+    matcher->output = NULL;
+
+    // Alfabeto reduzido: só os bytes usados nos padrões têm classe própria
+    memset(matcher->byte_class, 0, sizeof(matcher->byte_class));
+    int classes = 1;
+    int max_states = 1;
+    for (int p = 0; p < matcher->pattern_count; p++) {
+        for (int i = 0; i < matcher->pattern_len[p]; i++) {
+            unsigned char c = (unsigned char)matcher->patterns[p][i];
+            if (matcher->byte_class[c] == 0) {
+                matcher->byte_class[c] = (unsigned short)classes++;
+            }
+        }
+        max_states += matcher->pattern_len[p];
+    }
+
+    int *next = malloc(sizeof(int) * max_states * classes);
+    unsigned long long *output = calloc(max_states, sizeof(unsigned long long));
+    int *fail = malloc(sizeof(int) * max_states);
+    int *queue = malloc(sizeof(int) * max_states);
+    if (!next || !output || !fail || !queue) {
+        free(next);
+        free(output);
+        free(fail);
+        free(queue);
+        return -1;
+    }
+
+    // Trie dos padrões (-1: sem transição)
+    for (int i = 0; i < max_states * classes; i++) {
+        next[i] = -1;
+    }
+    int states = 1;
+    for (int p = 0; p < matcher->pattern_count; p++) {
+        int s = 0;
+        for (int i = 0; i < matcher->pattern_len[p]; i++) {
+            int c = matcher->byte_class[(unsigned char)matcher->patterns[p][i]];
+            if (next[s * classes + c] < 0) {
+                next[s * classes + c] = states++;
+            }
+            s = next[s * classes + c];
+        }
+        output[s] |= 1ULL << p;
+    }
+
+    // Ligações de falha em largura, completando as transições para obter um autómato determinístico
+    int head = 0, tail = 0;
+    for (int c = 0; c < classes; c++) {
+        int t = next[c];
+        if (t < 0) {
+            next[c] = 0;
+        } else {
+            fail[t] = 0;
+            queue[tail++] = t;
+        }
+    }
+    while (head < tail) {
+        int s = queue[head++];
+        output[s] |= output[fail[s]];
+        for (int c = 0; c < classes; c++) {
+            int t = next[s * classes + c];
+            if (t < 0) {
+                next[s * classes + c] = next[fail[s] * classes + c];
+            } else {
+                fail[t] = next[fail[s] * classes + c];
+                queue[tail++] = t;
+            }
+        }
+    }
+    free(fail);
+    free(queue);
+
+    matcher->next = next;
+    matcher->output = output;
+    matcher->state_count = states;
+    matcher->class_count = classes;
+    return 0;
+}
+
+void matcher_scan(const Matcher *matcher, const char *text, int len,
+                  unsigned long long *found, unsigned long long *at_start) {
+    *found = 0;
+    *at_start = 0;
+    if (!matcher->next) {
+        return;
+    }
+
+    int s = 0;
+    for (int i = 0; i < len; i++) {
+        s = matcher->next[s * matcher->class_count + matcher->byte_class[(unsigned char)text[i]]];
+        unsigned long long out = matcher->output[s];
+        if (!out) {
+            continue;
+        }
+        *found |= out;
+
+        // Um padrão que acaba em i começa no início do corpo se tiver i + 1 bytes
+        if (i < FILTER_PATTERN_LEN - 1) {
+            for (unsigned long long bits = out; bits; bits &= bits - 1) {
+                int p = __builtin_ctzll(bits);
+                if (matcher->pattern_len[p] == i + 1) {
+                    *at_start |= 1ULL << p;
+                }
+            }
+        }
+    }
+}
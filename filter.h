@@ -0,0 +1,50 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#define MAX_FILTER_LEN 128       // Texto do filtro enviado no corpo do SUB
+#define FILTER_MAX_PATTERNS 64   // Padrões distintos por tópico (um bit cada)
+#define FILTER_PATTERN_LEN 32    // Tamanho máximo de um padrão (com o '\0')
+#define FILTER_MAX_TERMS 8
+
+// Padrões de todos os filtros de um tópico, reunidos num só autómato Aho-Corasick
+// para que cada mensagem seja percorrida uma única vez na distribuição.
+typedef struct {
+    int pattern_count;
+    char patterns[FILTER_MAX_PATTERNS][FILTER_PATTERN_LEN];
+    unsigned char pattern_len[FILTER_MAX_PATTERNS];
+    int state_count;
+    int class_count;
+    unsigned short byte_class[256];  // Bytes que não aparecem em padrões ficam na classe 0
+    int *next;                       // Transições: state_count * class_count
+    unsigned long long *output;      // Padrões reconhecidos em cada estado
+} Matcher;
+
+// Filtro compilado: todos os termos têm de se verificar
+typedef struct {
+    char from[50];                   // de=<utilizador> (vazio: qualquer)
+    int dur_min;                     // dur>N / dur=N (INT_MIN: sem limite)
+    int dur_max;                     // dur<N / dur=N (INT_MAX: sem limite)
+    unsigned long long contains;     // contem=<texto>: bits de padrões que têm de ocorrer
+    unsigned long long prefix;       // prefixo=<texto>: bits de padrões que têm de iniciar o corpo
+} Filter;
+
+// Analisa o texto do filtro e regista os seus padrões no matcher (sem o reconstruir).
+// Devolve 0, ou -1 com a descrição do problema em error.
+int filter_compile(const char *text, Matcher *matcher, Filter *filter, char *error, int error_len);
+
+// 1 se a mensagem passa o filtro. found/at_start vêm de matcher_scan; has_body é 0
+// quando o corpo não foi analisado (blocos de mensagens longas) e os termos de conteúdo falham.
+int filter_match(const Filter *filter, const char *username, int duration,
+                 unsigned long long found, unsigned long long at_start, int has_body);
+
+// Constrói o autómato a partir dos padrões registados. Devolve -1 se faltar memória.
+int matcher_build(Matcher *matcher);
+
+// Percorre o texto uma vez e marca os padrões encontrados e os que começam na posição 0
+void matcher_scan(const Matcher *matcher, const char *text, int len,
+                  unsigned long long *found, unsigned long long *at_start);
+
+// Liberta o autómato e esquece os padrões
+void matcher_reset(Matcher *matcher);
+
+#endif
@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <string.h>
+#include "hist.h"
+
+static int hist_index(long long value) {
+    if (value < (1 << HIST_SUB_BITS)) {
+        return value < 0 ? 0 : (int)value;
+    }
+
+    int msb = 63 - __builtin_clzll((unsigned long long)value);
+    if (msb >= HIST_MAX_BITS) {
+        return HIST_BUCKETS - 1;
+    }
+    int shift = msb - (HIST_SUB_BITS - 1);
+    int mantissa = (int)(value >> shift); // Entre HIST_HALF e 2 * HIST_HALF - 1
+    return (1 << HIST_SUB_BITS) + (shift - 1) * HIST_HALF + (mantissa - HIST_HALF);
+}
+
+// Maior valor que cai no balde indicado
+static long long hist_bucket_value(int index) {
+    if (index < (1 << HIST_SUB_BITS)) {
+        return index;
+    }
+    int shift = (index - (1 << HIST_SUB_BITS)) / HIST_HALF + 1;
+    long long mantissa = (index - (1 << HIST_SUB_BITS)) % HIST_HALF + HIST_HALF;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+void hist_reset(Histogram *hist) {
+    memset(hist, 0, sizeof(*hist));
+}
+
+void hist_record(Histogram *hist, long long value) {
+    if (value < 0) {
+        value = 0;
+    }
+    if (hist->total == 0 || value < hist->min) hist->min = value;
+    if (value > hist->max) hist->max = value;
+    hist->counts[hist_index(value)]++;
+    hist->total++;
+    hist->sum += value;
+}
+
+long long hist_percentile(const Histogram *hist, double pct) {
+    if (hist->total == 0) {
+        return 0;
+    }
+
+    unsigned long long rank = (unsigned long long)(pct / 100.0 * hist->total + 0.5);
+    if (rank < 1) rank = 1;
+
+    unsigned long long seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += hist->counts[i];
+        if (seen >= rank) {
+            long long value = hist_bucket_value(i);
+            return value > hist->max ? hist->max : value;
+        }
+    }
+    return hist->max;
+}
+
+void hist_format(const Histogram *hist, char *out, int out_len) {
+    if (hist->total == 0) {
+        snprintf(out, out_len, "sem amostras");
+        return;
+    }
+
+    snprintf(out, out_len, "n=%llu min %.1f p50 %.1f p90 %.1f p99 %.1f p99.9 %.1f max %.1f média %.1f us",
+             hist->total, hist->min / 1e3,
+             hist_percentile(hist, 50) / 1e3, hist_percentile(hist, 90) / 1e3,
+             hist_percentile(hist, 99) / 1e3, hist_percentile(hist, 99.9) / 1e3,
+             hist->max / 1e3, hist->sum / hist->total / 1e3);
+}
@@ -0,0 +1,30 @@
+#ifndef HIST_H
+#define HIST_H
+
+// Histograma de latências ao estilo HDR: escala logarítmica com HIST_SUB_BITS bits de
+// mantissa por potência de 2 (erro relativo até 1/32), de 0 ns até 2^40 ns (~18 min).
+#define HIST_SUB_BITS 6
+#define HIST_MAX_BITS 40
+#define HIST_HALF (1 << (HIST_SUB_BITS - 1))
+#define HIST_BUCKETS ((1 << HIST_SUB_BITS) + (HIST_MAX_BITS - HIST_SUB_BITS) * HIST_HALF)
+
+typedef struct {
+    unsigned long long counts[HIST_BUCKETS];
+    unsigned long long total;
+    long long min;
+    long long max;
+    double sum;
+} Histogram;
+
+void hist_reset(Histogram *hist);
+
+// Regista um valor em ns (valores negativos contam como 0)
+void hist_record(Histogram *hist, long long value);
+
+// Valor (ns) abaixo do qual estão pct % das amostras
+long long hist_percentile(const Histogram *hist, double pct);
+
+// Resumo numa linha em microssegundos: amostras, mínimo, p50, p90, p99, p99.9, máximo e média
+void hist_format(const Histogram *hist, char *out, int out_len);
+
+#endif
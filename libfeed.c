@@ -0,0 +1,641 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include "libfeed.h"
+#include "protocol.h"
+
+#define CLIENT_PIPE_BASE "/tmp/feed_pipe_" // Base para o pipe exclusivo do feed
+#define CONNECT_WAIT_MS 5000 // Tempo máximo à espera da confirmação do manager
+#define MAX_TRANSFERS 4      // Mensagens longas a enviar em simultâneo
+#define MAX_INCOMING 8       // Mensagens longas a receber em simultâneo
+#define STREAM_INFLIGHT_MAX (4 * PIPE_BUF) // Bytes por ler no pipe do manager a partir dos quais o envio de blocos espera
+#define RECV_BUF_SIZE (16 * PIPE_BUF)      // Leituras do pipe exclusivo: várias tramas por chamada
+
+// libfeed.h repete os códigos do protocolo com valores explícitos: têm de coincidir com as
+// tabelas de protocol.h, que são as que o manager usa
+#define PROTOCOL_ENUM(op) PROTOCOL_##op,
+#define PROTOCOL_ERROR_ENUM(code, name) PROTOCOL_##code,
+enum { PROTOCOL_OP_UNKNOWN = 0, PROTOCOL_OPCODES(PROTOCOL_ENUM) PROTOCOL_OP_COUNT };
+enum { PROTOCOL_ERRORS(PROTOCOL_ERROR_ENUM) PROTOCOL_ERR_COUNT };
+#undef PROTOCOL_ENUM
+#undef PROTOCOL_ERROR_ENUM
+
+#define CHECK_OPCODE(op) _Static_assert(op == PROTOCOL_##op, "libfeed.h: " #op " diferente de protocol.h");
+#define CHECK_ERROR(code, name) _Static_assert(code == PROTOCOL_##code, "libfeed.h: " #code " diferente de protocol.h");
+PROTOCOL_OPCODES(CHECK_OPCODE)
+PROTOCOL_ERRORS(CHECK_ERROR)
+_Static_assert(OP_COUNT == PROTOCOL_OP_COUNT && ERR_COUNT == PROTOCOL_ERR_COUNT, "libfeed.h: códigos em falta");
+#undef CHECK_OPCODE
+#undef CHECK_ERROR
+
+// Mensagem longa a enviar, lida do ficheiro bloco a bloco
+typedef struct {
+    int active;
+    int fd;
+    unsigned int stream_id;
+    unsigned int offset;
+    unsigned int total;
+    char topic[MAX_TOPIC_NAME];
+} Transfer;
+
+// Mensagem longa a ser recebida
+typedef struct {
+    char username[50];
+    unsigned int stream_id;
+    char topic[MAX_TOPIC_NAME];
+    char *data;
+    unsigned int total;
+    unsigned int received;
+} Incoming;
+
+// Estado de uma ligação. Opaco para quem usa a biblioteca, para o formato poder mudar.
+struct FeedClient {
+    int client_fd;           // Pipe exclusivo (não bloqueante)
+    int manager_fd;
+    int options;             // FEED_*
+    int connected;
+    char username[50];
+    char pipe_name[100];
+    Transfer transfers[MAX_TRANSFERS];
+    unsigned int next_stream_id;
+    Incoming incoming[MAX_INCOMING];
+    char *delivered;         // Mensagem longa entregue na última chamada, libertada na seguinte
+    int saved_pos;           // Byte do buffer trocado pelo '\0' do corpo entregue (-1: nenhum)
+    char saved_byte;
+    int read_budget;         // Leituras do pipe permitidas nesta chamada (-1: sem limite)
+    int recv_start;          // Início da primeira trama por tratar
+    int recv_len;
+    char recv_buf[RECV_BUF_SIZE + 1]; // +1: espaço para o '\0' do corpo da última trama
+    Message scratch;         // Cabeçalho alinhado da trama atual (e corpo, se vier comprimido)
+    char notice[MAX_MSG_BODY + 1];
+    FeedMessage current;
+};
+
+static long long feed_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Prepara uma trama do feed para o manager
+static void feed_message_init(FeedClient *client, Message *msg, Opcode opcode, const char *topic) {
+    memset(msg, 0, FRAME_HEADER_SIZE);
+    protocol_set_action(msg, opcode);
+    strncpy(msg->username, client->username, sizeof(msg->username) - 1);
+    if (topic) {
+        strncpy(msg->topic, topic, sizeof(msg->topic) - 1);
+    }
+}
+
+static int feed_set_body(Message *msg, const char *body, int len) {
+    if (len < 0) {
+        len = (int)strlen(body);
+    }
+    if (len > MAX_MSG_BODY) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+    memcpy(msg->body, body, len);
+    msg->body[len] = '\0';
+    msg->body_len = msg->raw_len = (unsigned short)len;
+    return 0;
+}
+
+// Uma escrita de até PIPE_BUF bytes num pipe é atómica: tramas de vários feeds não se misturam
+static int feed_write(FeedClient *client, const void *data, size_t len) {
+    ssize_t n;
+    do {
+        n = write(client->manager_fd, data, len);
+    } while (n == -1 && errno == EINTR);
+    return n == (ssize_t)len ? 0 : -1;
+}
+
+static int feed_send(FeedClient *client, const Message *msg) {
+    return feed_write(client, msg, FRAME_HEADER_SIZE + msg->body_len);
+}
+
+// Espera pela resposta ao INIT. Devolve 0 se o manager aceitou a ligação.
+static int feed_wait_ack(FeedClient *client, char *reply, int reply_len) {
+    struct pollfd pfd = {client->client_fd, POLLIN, 0};
+    int ready;
+
+    do {
+        ready = poll(&pfd, 1, CONNECT_WAIT_MS);
+    } while (ready == -1 && errno == EINTR);
+
+    if (ready <= 0) {
+        snprintf(reply, reply_len, "O manager não respondeu ao pedido de ligação.");
+        return -1;
+    }
+
+    Message *ack = &client->scratch;
+    if (protocol_read_frame(client->client_fd, ack) != 1) {
+        snprintf(reply, reply_len, "Resposta inválida do manager.");
+        return -1;
+    }
+
+    // ERROR traz a razão da recusa; um ACK com corpo traz o resumo da sessão retomada
+    snprintf(reply, reply_len, "%s", ack->body);
+    return protocol_decode_action(ack->action) == OP_ACK ? 0 : -1;
+}
+
+FeedClient *feed_connect(const char *username, int options, char *reply, int reply_len) {
+    FeedClient *client = calloc(1, sizeof(FeedClient));
+    if (!client) {
+        snprintf(reply, reply_len, "Sem memória para o cliente.");
+        return NULL;
+    }
+    client->options = options;
+    client->saved_pos = -1;
+    client->read_budget = -1;
+    client->manager_fd = -1;
+    strncpy(client->username, username, sizeof(client->username) - 1);
+    snprintf(client->pipe_name, sizeof(client->pipe_name), "%s%s", CLIENT_PIPE_BASE, username);
+
+    // Criar o pipe exclusivo e abri-lo já (sem bloquear) para o manager o conseguir abrir de imediato
+    if (mkfifo(client->pipe_name, 0666) == -1) {
+        snprintf(reply, reply_len, "Erro ao criar pipe exclusivo do feed: %s", strerror(errno));
+        free(client);
+        return NULL;
+    }
+    client->client_fd = open(client->pipe_name, O_RDONLY | O_NONBLOCK);
+    if (client->client_fd == -1) {
+        snprintf(reply, reply_len, "Erro ao abrir pipe exclusivo para leitura: %s", strerror(errno));
+        unlink(client->pipe_name);
+        free(client);
+        return NULL;
+    }
+
+    client->manager_fd = open(MANAGER_PIPE, O_WRONLY);
+    if (client->manager_fd == -1) {
+        snprintf(reply, reply_len, "Erro ao abrir pipe do manager: %s", strerror(errno));
+        feed_close(client);
+        return NULL;
+    }
+
+    // Enviar informações iniciais ao manager (username e nome do pipe)
+    Message *init = &client->scratch;
+    feed_message_init(client, init, OP_INIT, NULL);
+    message_set_body(init, client->pipe_name);
+    init->flags = FRAME_ACCEPTS_COMPRESSED;
+    if (feed_send(client, init) == -1) {
+        snprintf(reply, reply_len, "Erro ao enviar pedido de ligação: %s", strerror(errno));
+        feed_close(client);
+        return NULL;
+    }
+
+    if (feed_wait_ack(client, reply, reply_len) != 0) {
+        feed_close(client);
+        return NULL;
+    }
+
+    client->connected = 1;
+    return client;
+}
+
+void feed_close(FeedClient *client) {
+    if (!client) {
+        return;
+    }
+
+    if (client->connected) {
+        Message exit_msg;
+        feed_message_init(client, &exit_msg, OP_EXIT, NULL);
+        feed_send(client, &exit_msg);
+    }
+
+    for (int i = 0; i < MAX_TRANSFERS; i++) {
+        if (client->transfers[i].active) {
+            close(client->transfers[i].fd);
+        }
+    }
+    for (int i = 0; i < MAX_INCOMING; i++) {
+        free(client->incoming[i].data);
+    }
+    free(client->delivered);
+
+    if (client->manager_fd != -1) {
+        close(client->manager_fd);
+    }
+    close(client->client_fd);
+    unlink(client->pipe_name);
+    free(client);
+}
+
+int feed_fd(const FeedClient *client) {
+    return client->client_fd;
+}
+
+int feed_connected(const FeedClient *client) {
+    return client->connected;
+}
+
+// 1 se o pipe do manager tem poucos bytes por ler, para que mensagens curtas (deste ou
+// de outros feeds) não fiquem atrás de uma fila de blocos
+static int feed_pipe_has_room(const FeedClient *client) {
+    int pending;
+    return ioctl(client->manager_fd, FIONREAD, &pending) != 0 || pending <= STREAM_INFLIGHT_MAX;
+}
+
+int feed_timeout(const FeedClient *client) {
+    for (int i = 0; i < MAX_TRANSFERS; i++) {
+        if (client->transfers[i].active) {
+            return feed_pipe_has_room(client) ? 0 : 1;
+        }
+    }
+    return -1;
+}
+
+int feed_subscribe(FeedClient *client, const char *topic, const char *filter) {
+    Message msg;
+    feed_message_init(client, &msg, OP_SUB, topic);
+    // O corpo do SUB, se existir, é o filtro da subscrição
+    if (feed_set_body(&msg, filter ? filter : "", -1) == -1) {
+        return -1;
+    }
+    return feed_send(client, &msg);
+}
+
+int feed_unsubscribe(FeedClient *client, const char *topic) {
+    Message msg;
+    feed_message_init(client, &msg, OP_UNSUB, topic);
+    msg.body_len = 0;
+    return feed_send(client, &msg);
+}
+
+// Prepara uma trama de publicação
+static int feed_build_publish(FeedClient *client, Message *msg, const FeedPublish *item) {
+    feed_message_init(client, msg, OP_MSG, item->topic);
+    if (feed_set_body(msg, item->body, item->len) == -1) {
+        return -1;
+    }
+    msg->duration = item->duration;
+    msg->priority = item->priority < QOS_CONTROL ? item->priority : QOS_NORMAL;
+    if (client->options & FEED_TRACE) {
+        msg->flags |= FRAME_TRACED;
+        msg->t_publish = feed_now_ns();
+    }
+    return 0;
+}
+
+int feed_publish(FeedClient *client, const char *topic, int duration, int priority, const char *body, int len) {
+    FeedPublish item = {topic, duration, priority, body, len};
+    Message msg;
+    if (feed_build_publish(client, &msg, &item) == -1) {
+        return -1;
+    }
+    return feed_send(client, &msg);
+}
+
+int feed_publish_batch(FeedClient *client, const FeedPublish *items, int count) {
+    char batch[PIPE_BUF];
+    int used = 0, sent = 0, queued = 0;
+    Message msg;
+
+    for (int i = 0; i < count; i++) {
+        if (feed_build_publish(client, &msg, &items[i]) == -1) {
+            break;
+        }
+
+        int frame_len = FRAME_HEADER_SIZE + msg.body_len;
+        if (used + frame_len > PIPE_BUF) {
+            if (feed_write(client, batch, used) == -1) {
+                return sent > 0 ? sent : -1;
+            }
+            sent += queued;
+            used = queued = 0;
+        }
+        memcpy(batch + used, &msg, frame_len);
+        used += frame_len;
+        queued++;
+    }
+
+    if (used > 0 && feed_write(client, batch, used) == 0) {
+        sent += queued;
+    }
+    return sent > 0 || count == 0 ? sent : -1;
+}
+
+int feed_publish_file(FeedClient *client, const char *topic, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size > MAX_STREAM_LEN) {
+        close(fd);
+        errno = EFBIG;
+        return -1;
+    }
+
+    for (int i = 0; i < MAX_TRANSFERS; i++) {
+        Transfer *transfer = &client->transfers[i];
+        if (!transfer->active) {
+            transfer->fd = fd;
+            transfer->stream_id = ++client->next_stream_id;
+            transfer->offset = 0;
+            transfer->total = (unsigned int)st.st_size;
+            strncpy(transfer->topic, topic, sizeof(transfer->topic) - 1);
+            transfer->active = 1;
+            return 0;
+        }
+    }
+
+    close(fd);
+    errno = EBUSY;
+    return -1;
+}
+
+// Envia o próximo bloco de uma transferência. Devolve 1 quando a transferência termina.
+static int feed_send_chunk(FeedClient *client, Transfer *transfer) {
+    Message *chunk = &client->scratch;
+    feed_message_init(client, chunk, OP_MSG, transfer->topic);
+
+    // Com erro de leitura a transferência termina com um último bloco vazio antes do fim:
+    // o manager fecha a mensagem longa e os subscritores descartam-na como incompleta
+    ssize_t len = pread(transfer->fd, chunk->body, MAX_MSG_BODY, transfer->offset);
+    if (len < 0) {
+        len = 0;
+    }
+    if (transfer->offset + len > transfer->total) {
+        len = transfer->total - transfer->offset; // O ficheiro cresceu entretanto
+    }
+
+    chunk->body_len = chunk->raw_len = (unsigned short)len;
+    chunk->flags = FRAME_CHUNK;
+    chunk->priority = QOS_BULK;
+    chunk->stream_id = transfer->stream_id;
+    chunk->stream_offset = transfer->offset;
+    chunk->stream_total = transfer->total;
+
+    transfer->offset += len;
+    int done = len == 0 || transfer->offset >= transfer->total;
+    if (done) {
+        chunk->flags |= FRAME_LAST;
+    }
+
+    feed_send(client, chunk);
+    return done;
+}
+
+// Envia um bloco de cada transferência ativa, enquanto o pipe do manager tiver espaço
+static void feed_send_chunks(FeedClient *client) {
+    for (int i = 0; i < MAX_TRANSFERS && feed_pipe_has_room(client); i++) {
+        Transfer *transfer = &client->transfers[i];
+        if (transfer->active && feed_send_chunk(client, transfer)) {
+            close(transfer->fd);
+            transfer->active = 0;
+        }
+    }
+}
+
+// Preenche a vista da mensagem a partir do cabeçalho em scratch
+static const FeedMessage *feed_view(FeedClient *client, const char *body, unsigned int body_len,
+                                    const void *frame, int frame_len) {
+    const Message *hdr = &client->scratch;
+    FeedMessage *view = &client->current;
+
+    view->size = sizeof(*view);
+    view->opcode = protocol_decode_action(hdr->action);
+    view->error = hdr->error;
+    view->topic = hdr->topic;
+    view->username = hdr->username;
+    view->duration = hdr->duration;
+    view->flags = hdr->flags;
+    view->priority = hdr->priority;
+    view->seq = hdr->seq;
+    view->body = body;
+    view->body_len = body_len;
+    view->stream_id = hdr->stream_id;
+    view->stream_offset = hdr->stream_offset;
+    view->stream_total = hdr->stream_total;
+    view->t_publish = hdr->t_publish;
+    view->t_dequeue = hdr->t_dequeue;
+    view->t_fanout = hdr->t_fanout;
+    view->frame = frame;
+    view->frame_len = frame_len;
+    return view;
+}
+
+// Descarta uma mensagem longa que não pode ser completada e devolve o aviso ao chamador
+static const FeedMessage *feed_stream_incomplete(FeedClient *client, Incoming *in) {
+    snprintf(client->notice, sizeof(client->notice), "Mensagem longa de '%s' incompleta: descartada", in->username);
+    free(in->data);
+    in->data = NULL;
+    FeedMessage *view = (FeedMessage *)feed_view(client, client->notice, (unsigned int)strlen(client->notice), NULL, 0);
+    view->opcode = OP_ERROR;
+    view->error = ERR_STREAM_REJECTED;
+    return view;
+}
+
+// Guarda um bloco de uma mensagem longa. Devolve a mensagem quando fica completa,
+// um aviso se um bloco se perdeu, ou NULL.
+static const FeedMessage *feed_receive_chunk(FeedClient *client, const char *body) {
+    const Message *msg = &client->scratch;
+    Incoming *incoming = client->incoming;
+    Incoming *in = NULL;
+    for (int i = 0; i < MAX_INCOMING; i++) {
+        if (incoming[i].data && incoming[i].stream_id == msg->stream_id &&
+            strcmp(incoming[i].username, msg->username) == 0) {
+            in = &incoming[i];
+            break;
+        }
+    }
+
+    if (!in && msg->stream_offset == 0 && msg->stream_total <= MAX_STREAM_LEN) {
+        for (int i = 0; i < MAX_INCOMING; i++) {
+            if (!incoming[i].data) {
+                in = &incoming[i];
+                in->data = malloc(msg->stream_total + 1);
+                if (!in->data) {
+                    return NULL;
+                }
+                strncpy(in->username, msg->username, sizeof(in->username));
+                strncpy(in->topic, msg->topic, sizeof(in->topic));
+                in->stream_id = msg->stream_id;
+                in->total = msg->stream_total;
+                in->received = 0;
+                break;
+            }
+        }
+    }
+
+    if (!in || msg->stream_offset + msg->body_len > in->total) {
+        return NULL; // Bloco sem início conhecido ou fora dos limites
+    }
+
+    // O manager descarta tramas quando a fila deste feed enche: com um bloco em falta
+    // a mensagem já não pode ser reconstruída
+    if (msg->stream_offset != in->received) {
+        return feed_stream_incomplete(client, in);
+    }
+
+    memcpy(in->data + msg->stream_offset, body, msg->body_len);
+    in->received += msg->body_len;
+
+    if (in->received < in->total) {
+        // Último bloco antes do fim: o emissor abandonou a transferência (erro de leitura)
+        return (msg->flags & FRAME_LAST) ? feed_stream_incomplete(client, in) : NULL;
+    }
+
+    // A mensagem completa é entregue com o tópico e o autor do primeiro bloco
+    client->delivered = in->data;
+    client->delivered[in->received] = '\0';
+    in->data = NULL;
+    FeedMessage *view = (FeedMessage *)feed_view(client, client->delivered, in->received, NULL, 0);
+    view->topic = in->topic;
+    view->username = in->username;
+    view->flags &= ~(FRAME_CHUNK | FRAME_LAST);
+    return view;
+}
+
+// Trata a trama que começa em frame (cabeçalho já copiado para scratch)
+static const FeedMessage *feed_decode(FeedClient *client, char *frame, int frame_len) {
+    Message *hdr = &client->scratch;
+    hdr->topic[sizeof(hdr->topic) - 1] = '\0';
+    hdr->username[sizeof(hdr->username) - 1] = '\0';
+
+    if (protocol_decode_action(hdr->action) == OP_EXIT) {
+        client->connected = 0; // O manager encerrou a plataforma
+        return NULL;
+    }
+
+    const char *body;
+    const void *wire = frame;
+    if (hdr->flags & FRAME_COMPRESSED) {
+        // Só as tramas comprimidas são copiadas: o corpo descomprimido fica em scratch
+        memcpy(hdr->body, frame + FRAME_HEADER_SIZE, hdr->body_len);
+        if (message_decompress(hdr) != 0) {
+            return NULL;
+        }
+        body = hdr->body;
+        wire = hdr;
+        frame_len = FRAME_HEADER_SIZE + hdr->body_len;
+    } else {
+        // O corpo fica no buffer: o byte seguinte é trocado por '\0' até à próxima chamada
+        body = frame + FRAME_HEADER_SIZE;
+        client->saved_pos = (int)(frame + frame_len - client->recv_buf);
+        client->saved_byte = client->recv_buf[client->saved_pos];
+        client->recv_buf[client->saved_pos] = '\0';
+    }
+
+    if ((hdr->flags & FRAME_CHUNK) && !(client->options & FEED_CHUNKS)) {
+        return feed_receive_chunk(client, body);
+    }
+    return feed_view(client, body, hdr->body_len, wire, frame_len);
+}
+
+// Lê do pipe exclusivo o que lá estiver, numa só chamada. Devolve 1 se leu alguma coisa.
+static int feed_read(FeedClient *client) {
+    if (client->read_budget == 0 || !client->connected) {
+        return 0;
+    }
+    if (client->read_budget > 0) {
+        client->read_budget--;
+    }
+
+    // Passar a trama incompleta para o início do buffer
+    client->recv_len -= client->recv_start;
+    memmove(client->recv_buf, client->recv_buf + client->recv_start, client->recv_len);
+    client->recv_start = 0;
+
+    ssize_t n = read(client->client_fd, client->recv_buf + client->recv_len, RECV_BUF_SIZE - client->recv_len);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+        client->connected = 0; // Pipe foi fechado pelo manager
+        return 0;
+    }
+    if (n < 0) {
+        return 0;
+    }
+    client->recv_len += n;
+    return 1;
+}
+
+// Devolve ao buffer o byte que o corpo da trama anterior emprestou para o '\0'
+static void feed_restore(FeedClient *client) {
+    if (client->saved_pos >= 0) {
+        client->recv_buf[client->saved_pos] = client->saved_byte;
+        client->saved_pos = -1;
+    }
+}
+
+const FeedMessage *feed_next(FeedClient *client) {
+    free(client->delivered);
+    client->delivered = NULL;
+
+    int did_read = 0;
+    while (client->connected) {
+        feed_restore(client);
+        int available = client->recv_len - client->recv_start;
+        if (available >= (int)FRAME_HEADER_SIZE) {
+            // O cabeçalho pode não estar alinhado no buffer: copiá-lo antes de o ler
+            char *frame = client->recv_buf + client->recv_start;
+            memcpy(&client->scratch, frame, FRAME_HEADER_SIZE);
+            if (client->scratch.body_len > MAX_MSG_BODY) {
+                client->connected = 0; // Trama inválida: a ligação já não está sincronizada
+                return NULL;
+            }
+
+            int frame_len = FRAME_HEADER_SIZE + client->scratch.body_len;
+            if (available >= frame_len) {
+                client->recv_start += frame_len;
+                const FeedMessage *msg = feed_decode(client, frame, frame_len);
+                if (msg) {
+                    return msg;
+                }
+                continue;
+            }
+        }
+
+        // Trama incompleta: ler mais uma vez
+        if (did_read || !feed_read(client)) {
+            return NULL;
+        }
+        did_read = 1;
+    }
+    return NULL;
+}
+
+int feed_dispatch(FeedClient *client, FeedCallback callback, void *arg) {
+    int delivered = 0;
+    const FeedMessage *msg;
+
+    // Uma só leitura do pipe por chamada, para um feed muito ativo não monopolizar o chamador
+    client->read_budget = 1;
+    while ((msg = feed_next(client)) != NULL) {
+        callback(client, msg, arg);
+        delivered++;
+    }
+    client->read_budget = -1;
+
+    if (client->connected) {
+        feed_send_chunks(client);
+    }
+    return client->connected || delivered > 0 ? delivered : -1;
+}
+
+int feed_poll(FeedClient *client, FeedCallback callback, void *arg, int timeout_ms) {
+    int pending = feed_timeout(client);
+    if (pending >= 0 && (timeout_ms < 0 || pending < timeout_ms)) {
+        timeout_ms = pending;
+    }
+
+    struct pollfd pfd = {client->client_fd, POLLIN, 0};
+    if (poll(&pfd, 1, timeout_ms) == -1 && errno != EINTR) {
+        return -1;
+    }
+    return feed_dispatch(client, callback, arg);
+}
+
+const char *feed_error_name(ErrorCode error) {
+    return protocol_error_name(error);
+}
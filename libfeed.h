@@ -0,0 +1,162 @@
+#ifndef LIBFEED_H
+#define LIBFEED_H
+
+// Biblioteca cliente da plataforma: liga-se ao manager como um feed e troca mensagens
+// sem passar pelo programa interativo. Não cria threads; o chamador pode usar o seu
+// próprio ciclo de eventos com feed_fd() e feed_timeout(), ou chamar feed_poll().
+//
+// Este ficheiro é a única interface pública: não inclui protocol.h. As constantes e os
+// códigos abaixo são os do protocolo (libfeed.c confirma-o na compilação).
+
+// Limites de tamanho
+#define MAX_TOPIC_NAME 20
+#define MAX_MSG_BODY 3840
+#define MAX_STREAM_LEN (8 * 1024 * 1024)
+#define MAX_FILTER_LEN 128
+
+// Flags das tramas (campo flags de FeedMessage)
+#define FRAME_COMPRESSED         0x01
+#define FRAME_ACCEPTS_COMPRESSED 0x02
+#define FRAME_CHUNK              0x04
+#define FRAME_LAST               0x08
+#define FRAME_TRACED             0x10
+
+// Classes de serviço (campo priority)
+#define QOS_NORMAL  0
+#define QOS_BULK    1
+#define QOS_URGENT  2
+#define QOS_CONTROL 3
+#define QOS_COUNT   4
+
+#ifndef LIBFEED_TYPES
+#define LIBFEED_TYPES
+// Códigos de erro das mensagens OP_ERROR (ver feed_error_name)
+typedef enum {
+    ERR_NONE = 0,
+    ERR_FEED_LIMIT = 1,
+    ERR_TOPIC_LOCKED = 2,
+    ERR_NOT_SUBSCRIBED = 3,
+    ERR_STREAM_REJECTED = 4,
+    ERR_RATE_USER = 5,
+    ERR_RATE_TOPIC = 6,
+    ERR_OVERLOAD = 7,
+    ERR_BAD_FILTER = 8,
+    ERR_COUNT
+} ErrorCode;
+
+// Opcodes do protocolo. Numa FeedMessage só aparecem OP_MSG, OP_ACK e OP_ERROR.
+typedef enum {
+    OP_UNKNOWN = 0,
+    OP_INIT = 1,
+    OP_EXIT = 2,
+    OP_MSG = 3,
+    OP_SUB = 4,
+    OP_UNSUB = 5,
+    OP_FILE = 6,
+    OP_URGENT = 7,
+    OP_ACK = 8,
+    OP_ERROR = 9,
+    OP_USERS = 10,
+    OP_REMOVE = 11,
+    OP_TOPICS = 12,
+    OP_SHOW = 13,
+    OP_LOCK = 14,
+    OP_UNLOCK = 15,
+    OP_COMPRESS = 16,
+    OP_LIMIT = 17,
+    OP_LIMITS = 18,
+    OP_LATENCY = 19,
+    OP_THREADS = 20,
+    OP_CLOSE = 21,
+    OP_COUNT
+} Opcode;
+#endif
+
+#define FEED_TRACE  0x01 // Mensagens publicadas com FRAME_TRACED (medição de latência)
+#define FEED_CHUNKS 0x02 // Entregar os blocos das mensagens longas um a um, sem os reconstruir
+
+typedef struct FeedClient FeedClient;
+
+// Mensagem recebida. Os ponteiros só são válidos até o callback voltar (ou até à
+// próxima chamada de feed_next): o corpo aponta diretamente para o buffer de receção.
+// A estrutura é sempre preenchida pela biblioteca: versões novas só acrescentam campos no
+// fim, e size diz até onde vai a da biblioteca carregada.
+typedef struct {
+    unsigned int size;       // sizeof(FeedMessage) na versão da biblioteca
+    Opcode opcode;           // OP_MSG, OP_ACK ou OP_ERROR
+    ErrorCode error;
+    const char *topic;
+    const char *username;
+    int duration;
+    int flags;               // FRAME_* da trama (FRAME_CHUNK só com FEED_CHUNKS)
+    int priority;
+    unsigned int seq;
+    const char *body;        // Terminado em '\0'
+    unsigned int body_len;   // Numa mensagem longa reconstruída pode exceder MAX_MSG_BODY
+    unsigned int stream_id;
+    unsigned int stream_offset;
+    unsigned int stream_total;
+    long long t_publish;     // Instantes da medição de latência (só com FRAME_TRACED)
+    long long t_dequeue;
+    long long t_fanout;
+    const void *frame;       // Trama tal como chegou, já descomprimida
+    int frame_len;
+} FeedMessage;
+
+// Mensagem a publicar num lote
+typedef struct {
+    const char *topic;
+    int duration;
+    int priority;            // QOS_NORMAL, QOS_URGENT ou QOS_BULK
+    const char *body;
+    int len;                 // -1: strlen(body)
+} FeedPublish;
+
+typedef void (*FeedCallback)(FeedClient *client, const FeedMessage *msg, void *arg);
+
+// Cria o pipe do feed, envia o INIT e espera pela confirmação. Em caso de sucesso reply
+// fica com o texto do ACK (vazio, ou o resumo da sessão retomada); em caso de erro, com
+// a descrição do problema e devolve NULL.
+FeedClient *feed_connect(const char *username, int options, char *reply, int reply_len);
+
+// Envia EXIT ao manager (se a ligação ainda estiver aberta), fecha os pipes e liberta o cliente
+void feed_close(FeedClient *client);
+
+// Descritor a vigiar com POLLIN no ciclo de eventos do chamador
+int feed_fd(const FeedClient *client);
+
+// Tempo máximo de espera (ms) para o poll do chamador: -1 sem envios pendentes,
+// 0 com blocos prontos a enviar, 1 com o pipe do manager cheio
+int feed_timeout(const FeedClient *client);
+
+// 1 enquanto a ligação estiver aberta (o manager não a encerrou nem fechou o pipe)
+int feed_connected(const FeedClient *client);
+
+// Devolvem 0, ou -1 com errno (EMSGSIZE: corpo maior do que MAX_MSG_BODY)
+int feed_subscribe(FeedClient *client, const char *topic, const char *filter);
+int feed_unsubscribe(FeedClient *client, const char *topic);
+int feed_publish(FeedClient *client, const char *topic, int duration, int priority, const char *body, int len);
+
+// Publica várias mensagens juntando as tramas em escritas de até PIPE_BUF bytes.
+// Devolve quantas foram enviadas, ou -1 se nenhuma foi.
+int feed_publish_batch(FeedClient *client, const FeedPublish *items, int count);
+
+// Começa a enviar um ficheiro como mensagem longa; os blocos seguem em feed_dispatch.
+// Devolve 0, ou -1 com errno (EFBIG: maior do que MAX_STREAM_LEN, EBUSY: envios a mais).
+int feed_publish_file(FeedClient *client, const char *topic, const char *path);
+
+// Próxima mensagem recebida, lendo do pipe sem bloquear se for preciso. NULL se não
+// houver nenhuma completa (ver feed_connected para distinguir o fim da ligação).
+const FeedMessage *feed_next(FeedClient *client);
+
+// Entrega ao callback as mensagens disponíveis e envia os blocos pendentes, sem bloquear.
+// Devolve quantas mensagens entregou, ou -1 se a ligação terminou.
+int feed_dispatch(FeedClient *client, FeedCallback callback, void *arg);
+
+// Espera até timeout_ms (-1: sem limite) por atividade e chama feed_dispatch
+int feed_poll(FeedClient *client, FeedCallback callback, void *arg, int timeout_ms);
+
+// Nome de um código de erro (campo error das mensagens OP_ERROR)
+const char *feed_error_name(ErrorCode error);
+
+#endif
@@ -1,688 +1,3102 @@
-#include "manager.h"
-
-
-void cleanup_and_exit(ManagerState *state) {
-    pthread_mutex_lock(&state->lock);
-
-    // Fechar e remover todos os feeds
-    for (int i = 0; i < state->feed_count; i++) {
-        close(state->feeds[i].pipe_fd);
-        unlink(state->feeds[i].pipe_name);
-    }
-
-    // Remover pipe principal
-    unlink(MANAGER_PIPE);
-
-    pthread_mutex_unlock(&state->lock);
-    pthread_mutex_destroy(&state->lock);
-
-    printf("\nRecursos libertados. A encerrar...\n");
-    exit(EXIT_SUCCESS);
-}
-
-
-void sigint_handler(int signo) {
-    extern ManagerState global_state; // Estado global para acesso no manipulador
-    cleanup_and_exit(&global_state);
-}
-
-void init_manager_state(ManagerState *state) {
-    state->feed_count = 0;
-    state->topic_count = 0;
-    pthread_mutex_init(&state->lock, NULL);
-}
-
-int add_feed(ManagerState *state, const char *username, const char *pipe_name) {
-    pthread_mutex_lock(&state->lock);
-
-    if (state->feed_count >= MAX_FEEDS) {
-        pthread_mutex_unlock(&state->lock);
-        return -1;
-    }
-
-    Feed *feed = &state->feeds[state->feed_count];
-    strncpy(feed->username, username, sizeof(feed->username));
-    strncpy(feed->pipe_name, pipe_name, sizeof(feed->pipe_name));
-
-    feed->pipe_fd = open(pipe_name, O_WRONLY);
-    if (feed->pipe_fd == -1) {
-        perror("Erro ao abrir pipe exclusivo do feed");
-        pthread_mutex_unlock(&state->lock);
-        return -1;
-    }
-
-    state->feed_count++;
-    pthread_mutex_unlock(&state->lock);
-    return 0;
-}
-
-void remove_feed(ManagerState *state, const char *username) {
-    pthread_mutex_lock(&state->lock);
-
-    for (int i = 0; i < state->feed_count; i++) {
-        if (strcmp(state->feeds[i].username, username) == 0) {
-            close(state->feeds[i].pipe_fd);
-            unlink(state->feeds[i].pipe_name);
-
-            state->feeds[i] = state->feeds[state->feed_count - 1];
-            state->feed_count--;
-            break;
-        }
-    }
-
-    pthread_mutex_unlock(&state->lock);
-}
-
-Topic *get_or_create_topic(ManagerState *state, const char *name) {
-    for (int i = 0; i < state->topic_count; i++) {
-        if (strcmp(state->topics[i].name, name) == 0) {
-            return &state->topics[i];
-        }
-    }
-
-    if (state->topic_count >= MAX_TOPICS) {
-        return NULL; // Limite de tópicos atingido
-    }
-
-    Topic *topic = &state->topics[state->topic_count];
-    strncpy(topic->name, name, MAX_TOPIC_NAME);
-    topic->sub_count = 0;
-    topic->msg_count = 0;
-    state->topic_count++;
-
-    return topic;
-}
-
-void subscribe_feed_to_topic(ManagerState *state, const char *username, const char *topic_name) {
-    pthread_mutex_lock(&state->lock);
-
-    Topic *topic = get_or_create_topic(state, topic_name);
-    if (!topic) {
-        printf("Erro: Limite de tópicos atingido ou falha ao criar tópico.\n");
-        pthread_mutex_unlock(&state->lock);
-        return;
-    }
-
-    for (int i = 0; i < state->feed_count; i++) {
-        if (strcmp(state->feeds[i].username, username) == 0) {
-            if (topic->sub_count < MAX_FEEDS) {
-                topic->subscribers[topic->sub_count++] = &state->feeds[i];
-                printf("Feed '%s' subscrito ao tópico '%s'.\n", username, topic_name);
-            } else {
-                printf("Erro: Limite de subscritores no tópico '%s'.\n", topic_name);
-            }
-            break;
-        }
-    }
-
-    pthread_mutex_unlock(&state->lock);
-}
-
-// Remove um feed de um tópico
-void unsubscribe_feed_from_topic(ManagerState *state, const char *username, const char *topic_name) {
-    pthread_mutex_lock(&state->lock);
-
-    for (int i = 0; i < state->topic_count; i++) {
-        if (strcmp(state->topics[i].name, topic_name) == 0) {
-            Topic *topic = &state->topics[i];
-
-            for (int j = 0; j < topic->sub_count; j++) {
-                if (strcmp(topic->subscribers[j]->username, username) == 0) {
-                    // Remover subscrição
-                    topic->subscribers[j] = topic->subscribers[topic->sub_count - 1];
-                    topic->sub_count--;
-                    printf("Feed '%s' cancelou subscrição do tópico '%s'.\n", username, topic_name);
-
-                    // Remover o tópico se não houver subscritores
-                    if (topic->sub_count == 0) {
-                        state->topics[i] = state->topics[state->topic_count - 1];
-                        state->topic_count--;
-                        printf("Tópico '%s' removido (sem subscritores).\n", topic_name);
-                    }
-
-                    pthread_mutex_unlock(&state->lock);
-                    return;
-                }
-            }
-
-            printf("Feed '%s' não está subscrito ao tópico '%s'.\n", username, topic_name);
-        }
-    }
-
-    printf("Tópico '%s' não encontrado.\n", topic_name);
-    pthread_mutex_unlock(&state->lock);
-}
-
-void process_message(ManagerState *state, const Message *msg) {
-    pthread_mutex_lock(&state->lock);
-
-    // Obter o tópico
-    Topic *topic = NULL;
-    for (int i = 0; i < state->topic_count; i++) {
-        if (strcmp(state->topics[i].name, msg->topic) == 0) {
-            topic = &state->topics[i];
-            break;
-        }
-    }
-
-    if (!topic) {
-        printf("Erro: Tópico '%s' não encontrado.\n", msg->topic);
-        pthread_mutex_unlock(&state->lock);
-        return;
-    }
-
-    // Verificar se o tópico está bloqueado
-    if (topic->is_locked) {
-        printf("Erro: Tópico '%s' está bloqueado. Mensagem rejeitada.\n", msg->topic);
-
-        // Notificar o feed enviador
-        for (int i = 0; i < state->feed_count; i++) {
-            if (strcmp(state->feeds[i].username, msg->username) == 0) {
-                Message error_msg = {0};
-                strncpy(error_msg.action, "ERROR", sizeof(error_msg.action));
-                strncpy(error_msg.username, "SYSTEM", sizeof(error_msg.username));
-                snprintf(error_msg.body, sizeof(error_msg.body), "Erro: Tópico '%s' está bloqueado. Mensagem rejeitada.", msg->topic);
-
-                if (write(state->feeds[i].pipe_fd, &error_msg, sizeof(Message)) == -1) {
-                    perror("Erro ao enviar mensagem de erro ao feed");
-                }
-                break;
-            }
-        }
-
-        pthread_mutex_unlock(&state->lock);
-        return;
-    }
-
-    // Verificar se o feed está subscrito ao tópico
-    int is_subscribed = 0;
-    for (int i = 0; i < topic->sub_count; i++) {
-        if (strcmp(topic->subscribers[i]->username, msg->username) == 0) {
-            is_subscribed = 1;
-            break;
-        }
-    }
-
-    if (!is_subscribed) {
-        printf("Erro: Feed '%s' tentou enviar mensagem ao tópico '%s' sem estar subscrito.\n", msg->username, msg->topic);
-
-        // Notificar o feed enviador
-        for (int i = 0; i < state->feed_count; i++) {
-            if (strcmp(state->feeds[i].username, msg->username) == 0) {
-                Message error_msg = {0};
-                strncpy(error_msg.action, "ERROR", sizeof(error_msg.action));
-                strncpy(error_msg.username, "SYSTEM", sizeof(error_msg.username));
-                snprintf(error_msg.body, sizeof(error_msg.body), "Erro: Não subscrito ao tópico '%s'. Mensagem rejeitada.", msg->topic);
-
-                if (write(state->feeds[i].pipe_fd, &error_msg, sizeof(Message)) == -1) {
-                    perror("Erro ao enviar mensagem de erro ao feed");
-                }
-                break;
-            }
-        }
-
-        pthread_mutex_unlock(&state->lock);
-        return;
-    }
-
-    // Guardar mensagens persistentes
-    if (msg->duration > 0 && topic->msg_count < 5) {
-        // Inicializar a mensagem na posição atual
-        topic->messages[topic->msg_count] = *msg;
-
-        // Adicionar o tempo relativo
-        topic->messages[topic->msg_count].created_time = state->ticks;
-
-        // Incrementar o contador apenas após a inicialização
-        topic->msg_count++;
-    }
-
-    // Enviar mensagem para todos os subscritores
-    for (int i = 0; i < topic->sub_count; i++) {
-        if (write(topic->subscribers[i]->pipe_fd, msg, sizeof(Message)) == -1) {
-            perror("Erro ao enviar mensagem ao feed");
-        }
-    }
-
-    printf("Mensagem enviada ao tópico '%s' por '%s'.\n", msg->topic, msg->username);
-    pthread_mutex_unlock(&state->lock);
-}
-
-
-
-void process_command(ManagerState *state, const Message *msg) {
-    if (strcmp(msg->action, "INIT") == 0) {
-        if (add_feed(state, msg->username, msg->body) == 0) {
-            printf("Feed '%s' conectado.\n", msg->username);
-        } else {
-            printf("Erro: Limite de feeds atingido ou falha na conexão.\n");
-        }
-    } else if (strcmp(msg->action, "EXIT") == 0) {
-        printf("Feed '%s' desconectado.\n", msg->username);
-        remove_feed(state, msg->username);
-    } else if (strcmp(msg->action, "MSG") == 0) {
-        process_message(state, msg);
-    } else if (strcmp(msg->action, "SUB") == 0) {
-        subscribe_feed_to_topic(state, msg->username, msg->topic);
-    } else if(strcmp(msg->action, "UNSUB")==0){
-        unsubscribe_feed_from_topic(state,msg->username, msg->topic);
-    } 
-}
-
-
-// Lista os utilizadores conectados
-void list_users(ManagerState *state) {
-    pthread_mutex_lock(&state->lock);
-    printf("Utilizadores conectados:\n");
-    for (int i = 0; i < state->feed_count; i++) {
-        printf("- %s\n", state->feeds[i].username);
-    }
-    pthread_mutex_unlock(&state->lock);
-}
-
-// Remove um utilizador
-void remove_user(ManagerState *state, const char *username) {
-    pthread_mutex_lock(&state->lock);
-    for (int i = 0; i < state->feed_count; i++) {
-        if (strcmp(state->feeds[i].username, username) == 0) {
-            // Notificar o feed a ser removido
-            Message msg = {0};
-            strncpy(msg.action, "EXIT", sizeof(msg.action));
-            if (write(state->feeds[i].pipe_fd, &msg, sizeof(Message)) == -1) {
-                perror("Erro ao notificar feed");
-            }
-
-            close(state->feeds[i].pipe_fd);
-            unlink(state->feeds[i].pipe_name);
-
-            // Notificar outros feeds
-            Message notif = {0};
-            snprintf(notif.body, sizeof(notif.body), "Utilizador '%s' foi removido.", username);
-            for (int j = 0; j < state->feed_count; j++) {
-                if (j != i) {
-                    write(state->feeds[j].pipe_fd, &notif, sizeof(Message));
-                }
-            }
-
-            // Remover o feed
-            state->feeds[i] = state->feeds[state->feed_count - 1];
-            state->feed_count--;
-
-            printf("Utilizador '%s' removido.\n", username);
-            pthread_mutex_unlock(&state->lock);
-            return;
-        }
-    }
-    printf("Utilizador '%s' não encontrado.\n", username);
-    pthread_mutex_unlock(&state->lock);
-}
-
-// Lista os tópicos existentes
-void list_topics(ManagerState *state) {
-    pthread_mutex_lock(&state->lock);
-    printf("Tópicos existentes:\n");
-    for (int i = 0; i < state->topic_count; i++) {
-        printf("- %s (Mensagens persistentes: %d, Bloqueado: %s)\n", 
-               state->topics[i].name, state->topics[i].msg_count, 
-               state->topics[i].is_locked ? "Sim" : "Não");
-    }
-    pthread_mutex_unlock(&state->lock);
-}
-
-// Mostra as mensagens de um tópico
-void show_topic_messages(ManagerState *state, const char *topic_name) {
-    pthread_mutex_lock(&state->lock);
-    for (int i = 0; i < state->topic_count; i++) {
-        if (strcmp(state->topics[i].name, topic_name) == 0) {
-            printf("Mensagens no tópico '%s':\n", topic_name);
-            for (int j = 0; j < state->topics[i].msg_count; j++) {
-                printf("- %s: %s\n", state->topics[i].messages[j].username, state->topics[i].messages[j].body);
-            }
-            pthread_mutex_unlock(&state->lock);
-            return;
-        }
-    }
-    printf("Tópico '%s' não encontrado.\n", topic_name);
-    pthread_mutex_unlock(&state->lock);
-}
-
-// Bloqueia ou desbloqueia um tópico
-void set_topic_lock(ManagerState *state, const char *topic_name, int lock) {
-    pthread_mutex_lock(&state->lock);
-    for (int i = 0; i < state->topic_count; i++) {
-        if (strcmp(state->topics[i].name, topic_name) == 0) {
-            state->topics[i].is_locked = lock;
-            printf("Tópico '%s' %s.\n", topic_name, lock ? "bloqueado" : "desbloqueado");
-            pthread_mutex_unlock(&state->lock);
-            return;
-        }
-    }
-    printf("Tópico '%s' não encontrado.\n", topic_name);
-    pthread_mutex_unlock(&state->lock);
-}
-
-// Encerra a plataforma
-void close_platform(ManagerState *state) {
-    pthread_mutex_lock(&state->lock);
-    state->running = 0;
-
-    // Notificar todos os feeds
-    Message msg = {0};
-    strncpy(msg.action, "EXIT", sizeof(msg.action));
-    for (int i = 0; i < state->feed_count; i++) {
-        if (write(state->feeds[i].pipe_fd, &msg, sizeof(Message)) == -1) {
-            perror("Erro ao notificar feed");
-        }
-        close(state->feeds[i].pipe_fd);
-        unlink(state->feeds[i].pipe_name);
-    }
-    printf("Plataforma encerrada.\n");
-
-    pthread_mutex_unlock(&state->lock);
-}
-
-// Thread para comandos do administrador
-void *admin_commands(void *arg) {
-    ManagerState *state = (ManagerState *)arg;
-    char command[100];
-
-    while (state->running) {
-        printf("Admin> ");
-        if (fgets(command, sizeof(command), stdin) == NULL) break;
-
-        command[strcspn(command, "\n")] = '\0'; // Remover newline
-
-        if (strcmp(command, "users") == 0) {
-            list_users(state);
-        } else if (strncmp(command, "remove ", 7) == 0) {
-            if (strlen(command + 7) == 0) {
-                printf("Erro: O comando 'remove' requer um <username>. Uso: remove <username>\n");
-            } else {
-                remove_user(state, command + 7);
-            }
-        } else if (strcmp(command, "topics") == 0) {
-            list_topics(state);
-        } else if (strncmp(command, "show ", 5) == 0) {
-            if (strlen(command + 5) == 0) {
-                printf("Erro: O comando 'show' requer um <topico>. Uso: show <topico>\n");
-            } else {
-                show_topic_messages(state, command + 5);
-            }
-        } else if (strncmp(command, "lock ", 5) == 0) {
-            if (strlen(command + 5) == 0) {
-                printf("Erro: O comando 'lock' requer um <topico>. Uso: lock <topico>\n");
-            } else {
-                set_topic_lock(state, command + 5, 1);
-            }
-        } else if (strncmp(command, "unlock ", 7) == 0) {
-            if (strlen(command + 7) == 0) {
-                printf("Erro: O comando 'unlock' requer um <topico>. Uso: unlock <topico>\n");
-            } else {
-                set_topic_lock(state, command + 7, 0);
-            }
-        } else if (strcmp(command, "close") == 0) {
-            close_platform(state);
-            break;
-        } else {
-            printf("Comando desconhecido: %s. Tente um dos seguintes: users, remove, topics, show, lock, unlock, close\n", command);
-        }
-    }
-
-    return NULL;
-}
-
-void *process_commands_thread(void *arg) {
-    struct {
-        int fd;
-        ManagerState *state;
-    } *params = arg;
-
-    int manager_fd = params->fd;
-    ManagerState *state = params->state;
-
-    Message msg;
-
-    while (state->running) {
-        ssize_t bytes_read = read(manager_fd, &msg, sizeof(Message));
-        if (bytes_read > 0) {
-            // Processar comando recebido
-            process_command(state, &msg);
-        } else if (bytes_read == 0) {
-            // Fim de comunicação
-            break;
-        } else {
-            perror("Erro ao ler do pipe do manager");
-        }
-    }
-
-    printf("Thread de processamento de comandos encerrada.\n");
-    return NULL;
-}
-
-
-// Função para a Thread de Monitorização
-void *monitor_persistent_messages(void *arg) {
-    ManagerState *state = (ManagerState *)arg;
-
-    while (state->running) {
-        pthread_mutex_lock(&state->lock);
-
-        // Incrementar "ticks"
-        state->ticks++;
-
-        for (int i = 0; i < state->topic_count; i++) {
-            Topic *topic = &state->topics[i];
-
-            // Verificar mensagens persistentes no tópico
-            int new_count = 0;
-            for (int j = 0; j < topic->msg_count; j++) {
-                Message *msg = &topic->messages[j];
-                if (state->ticks - msg->created_time < msg->duration) {
-                    topic->messages[new_count++] = *msg;
-                } else {
-                    printf("Mensagem de '%s' no tópico '%s' expirou e foi removida.\n",
-                           msg->username, msg->topic);
-                }
-            }
-            topic->msg_count = new_count;
-        }
-
-        pthread_mutex_unlock(&state->lock);
-
-        sleep(1); // Simular "tick" a cada 1 segundo
-    }
-
-    return NULL;
-}
-
-void save_persistent_messages(ManagerState *state) {
-    const char *filename = getenv("MSG_FICH");
-    if (!filename) {
-        printf("Erro: Variável de ambiente MSG_FICH não definida.\n");
-        return;
-    }
-
-    FILE *file = fopen(filename, "w");
-    if (!file) {
-        perror("Erro ao abrir ficheiro para salvar mensagens");
-        return;
-    }
-
-    pthread_mutex_lock(&state->lock);
-
-    for (int i = 0; i < state->topic_count; i++) {
-        Topic *topic = &state->topics[i];
-        for (int j = 0; j < topic->msg_count; j++) {
-            Message *msg = &topic->messages[j];
-            int remaining_time = msg->duration - (state->ticks - msg->created_time);
-
-            if (remaining_time > 0) {
-                fprintf(file, "%s %s %d %s\n", 
-                        topic->name, 
-                        msg->username, 
-                        remaining_time, 
-                        msg->body);
-            }
-        }
-    }
-
-    pthread_mutex_unlock(&state->lock);
-    fclose(file);
-
-    printf("Mensagens persistentes salvas no '%s'.\n", filename);
-}
-
-void load_persistent_messages(ManagerState *state) {
-    const char *filename = getenv("MSG_FICH");
-    if (!filename) {
-        printf("Erro: Variável de ambiente MSG_FICH não definida.\n");
-        return;
-    }
-
-    FILE *file = fopen(filename, "r");
-    if (!file) {
-        perror("Erro ao abrir ficheiro para carregar mensagens");
-        return;
-    }
-
-    pthread_mutex_lock(&state->lock);
-
-    char line[512];
-    while (fgets(line, sizeof(line), file)) {
-        char topic_name[MAX_TOPIC_NAME];
-        char username[50];
-        int remaining_time;
-        char body[MAX_MSG_BODY];
-
-        // Ler os campos do ficheiro
-        if (sscanf(line, "%s %s %d %[^\n]", topic_name, username, &remaining_time, body) != 4) {
-            printf("Erro: Linha inválida no ficheiro: %s\n", line);
-            continue;
-        }
-
-        // Encontrar ou criar o tópico
-        Topic *topic = NULL;
-        for (int i = 0; i < state->topic_count; i++) {
-            if (strcmp(state->topics[i].name, topic_name) == 0) {
-                topic = &state->topics[i];
-                break;
-            }
-        }
-        if (!topic && state->topic_count < MAX_TOPICS) {
-            topic = &state->topics[state->topic_count++];
-            strncpy(topic->name, topic_name, MAX_TOPIC_NAME);
-            topic->sub_count = 0;
-            topic->msg_count = 0;
-            topic->is_locked = 0;
-        }
-
-        if (!topic) {
-            printf("Erro: Limite de tópicos atingido ao carregar mensagem do tópico '%s'.\n", topic_name);
-            continue;
-        }
-
-        // Adicionar a mensagem ao tópico
-        if (topic->msg_count < 5) {
-            Message *msg = &topic->messages[topic->msg_count++];
-            strncpy(msg->username, username, sizeof(msg->username));
-            strncpy(msg->body, body, sizeof(msg->body));
-            msg->duration = remaining_time;
-
-            // Ajustar o tempo de criação com base no `ticks` atual
-            msg->created_time = state->ticks;
-        } else {
-            printf("Erro: Limite de mensagens atingido no tópico '%s'.\n", topic_name);
-        }
-    }
-
-    pthread_mutex_unlock(&state->lock);
-    fclose(file);
-
-    printf("Mensagens persistentes recuperadas de '%s'.\n", filename);
-}
-
-
-
-int main() {
-    int manager_fd;
-    ManagerState state;
-
-    init_manager_state(&state);
-
-    // Configurar manipulador de sinal
-    signal(SIGINT, sigint_handler);
-
-    // Inicializar o contador de ticks
-    state.ticks = 0;
-
-    // Recuperar mensagens persistentes do ficheiro (se existir)
-    load_persistent_messages(&state);
-
-    // Criar o pipe principal
-    if (mkfifo(MANAGER_PIPE, 0666) == -1) {
-        perror("Erro ao criar pipe do manager");
-        return EXIT_FAILURE;
-    }
-
-    // Abrir o pipe principal em leitura e escrita para evitar bloqueios
-    manager_fd = open(MANAGER_PIPE, O_RDWR);
-    if (manager_fd == -1) {
-        perror("Erro ao abrir pipe do manager");
-        unlink(MANAGER_PIPE);
-        return EXIT_FAILURE;
-    }
-
-    printf("Manager iniciado. Aguardando conexões...\n");
-
-    // Iniciar a thread para comandos administrativos
-    pthread_t admin_thread;
-    if (pthread_create(&admin_thread, NULL, admin_commands, &state) != 0) {
-        perror("Erro ao criar thread administrativa");
-        close(manager_fd);
-        unlink(MANAGER_PIPE);
-        return EXIT_FAILURE;
-    }
-
-    // Iniciar a thread para monitorar mensagens persistentes
-    pthread_t monitor_thread;
-    if (pthread_create(&monitor_thread, NULL, monitor_persistent_messages, &state) != 0) {
-        perror("Erro ao criar thread de monitorização");
-        close(manager_fd);
-        unlink(MANAGER_PIPE);
-        return EXIT_FAILURE;
-    }
-
-    // Iniciar a thread para processar mensagens do pipe
-    pthread_t command_thread;
-    struct {
-        int fd;
-        ManagerState *state;
-    } params = {manager_fd, &state};
-
-    if (pthread_create(&command_thread, NULL, process_commands_thread, &params) != 0) {
-        perror("Erro ao criar thread de processamento de comandos");
-        close(manager_fd);
-        unlink(MANAGER_PIPE);
-        return EXIT_FAILURE;
-    }
-
-    // Esperar a thread administrativa encerrar
-    pthread_join(admin_thread, NULL);
-    state.running = 0; // Sinalizar para as threads secundárias pararem
-
-    // Esperar as threads secundárias encerrarem
-    pthread_join(monitor_thread, NULL);
-    pthread_join(command_thread, NULL);
-
-    // Salvar mensagens persistentes antes de encerrar
-    save_persistent_messages(&state);
-
-    // Encerrar o manager
-    close(manager_fd);
-    unlink(MANAGER_PIPE);
-
-    pthread_mutex_destroy(&state.lock);
-    printf("Manager encerrado.\n");
-
-    return EXIT_SUCCESS;
-}
+#include "manager.h"
+
+
+void cleanup_and_exit(ManagerState *state) {
+    pthread_mutex_lock(&state->lock);
+
+    // Fechar e remover todos os feeds
+    for (int i = 0; i < state->feed_count; i++) {
+        close(state->feeds[i].pipe_fd);
+        unlink(state->feeds[i].pipe_name);
+    }
+
+    // Remover pipe principal
+    unlink(MANAGER_PIPE);
+
+    pthread_mutex_unlock(&state->lock);
+    pthread_mutex_destroy(&state->lock);
+
+    printf("\nRecursos libertados. A encerrar...\n");
+    exit(EXIT_SUCCESS);
+}
+
+
+void sigint_handler(int signo) {
+    extern ManagerState global_state; // Estado global para acesso no manipulador
+    cleanup_and_exit(&global_state);
+}
+
+void init_manager_state(ManagerState *state) {
+    state->feed_count = 0;
+    state->topic_count = 0;
+    state->pending_count = 0;
+    state->rejected_count = 0;
+    state->stream_count = 0;
+    state->limit_count = 0;
+    state->inherited_count = 0;
+    state->shed_count = 0;
+    state->removed_count = 0;
+    state->snapshot_full = 1; // O primeiro snapshot reescreve o diário com o estado recuperado
+    state->snapshot_fd = -1;
+    state->snapshot_path[0] = '\0'; // Sem MSG_FICH não há diário
+    state->topic_dir = NULL;
+    state->rcu_epoch = 1;
+    memset(state->rcu_active, 0, sizeof(state->rcu_active));
+    state->retired_count = 0;
+    state->record_file = NULL;
+    state->record_pending = 0;
+    state->replay = 0;
+    state->replay_hist = NULL;
+    state->cpu_rule_count = 0;
+    state->thread_count = 0;
+    state->inbound_pending = 0;
+    state->spin_max_ns = SPIN_DEFAULT_US * 1000LL;
+    state->running = 1;
+    memset(state->inbound, 0, sizeof(state->inbound));
+    memset(state->inbound_credits, 0, sizeof(state->inbound_credits));
+    pthread_mutex_init(&state->lock, NULL);
+    pthread_mutex_init(&state->queue_lock, NULL);
+    pthread_cond_init(&state->queue_ready, NULL);
+
+    if (pipe2(state->wake_fds, O_NONBLOCK | O_CLOEXEC) == -1) {
+        perror("Erro ao criar pipe de despertar");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Pesos do escalonamento ponderado. O controlo tem prioridade estrita e não usa créditos.
+static const int qos_weights[QOS_COUNT] = {
+    [QOS_NORMAL]  = 4,
+    [QOS_BULK]    = 1,
+    [QOS_URGENT]  = 8,
+    [QOS_CONTROL] = 0,
+};
+
+// Acrescenta uma trama ao fim da fila. Devolve -1 se a fila estiver cheia.
+int queue_push(FrameQueue *queue, Message *frame) {
+    if (queue->count >= QUEUE_CAPACITY) {
+        return -1;
+    }
+    queue->frames[(queue->head + queue->count) % QUEUE_CAPACITY] = frame;
+    queue->count++;
+    return 0;
+}
+
+Message *queue_peek(FrameQueue *queue) {
+    return queue->count > 0 ? queue->frames[queue->head] : NULL;
+}
+
+Message *queue_pop(FrameQueue *queue) {
+    Message *frame = queue_peek(queue);
+    if (frame) {
+        queue->head = (queue->head + 1) % QUEUE_CAPACITY;
+        queue->count--;
+    }
+    return frame;
+}
+
+// Liberta todas as tramas da fila
+void queue_clear(FrameQueue *queue) {
+    Message *frame;
+    while ((frame = queue_pop(queue)) != NULL) {
+        free(frame);
+    }
+}
+
+// Escolhe a classe a servir a seguir. O controlo passa sempre à frente; as restantes
+// classes partilham a vez na proporção de qos_weights. Devolve -1 se não houver tramas.
+int qos_pick(FrameQueue queues[QOS_COUNT], int credits[QOS_COUNT]) {
+    static const int order[] = {QOS_URGENT, QOS_NORMAL, QOS_BULK};
+
+    if (queues[QOS_CONTROL].count > 0) {
+        return QOS_CONTROL;
+    }
+
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < 3; i++) {
+            int qos = order[i];
+            if (queues[qos].count > 0 && credits[qos] > 0) {
+                credits[qos]--;
+                return qos;
+            }
+        }
+
+        // Créditos das classes com tramas esgotados: começar nova ronda
+        for (int i = 0; i < 3; i++) {
+            credits[order[i]] = qos_weights[order[i]];
+        }
+    }
+    return -1;
+}
+
+// Acorda a thread de entrega (escrita não bloqueante; um byte pendente já chega)
+void wake_delivery(ManagerState *state) {
+    char byte = 1;
+    if (write(state->wake_fds[1], &byte, 1) == -1 && errno != EAGAIN) {
+        perror("Erro ao acordar a thread de entrega");
+    }
+}
+
+// Coloca uma cópia da trama na fila do feed, na classe msg->priority. Se a fila
+// estiver cheia a trama é descartada. Chamar com state->lock adquirido.
+void enqueue_for_feed(ManagerState *state, Feed *feed, const Message *msg) {
+    Message *frame = message_clone(msg);
+    if (!frame || queue_push(&feed->out[msg->priority], frame) != 0) {
+        free(frame);
+        feed->dropped++;
+        return;
+    }
+    wake_delivery(state);
+}
+
+long long monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+long long monotonic_ms(void) {
+    return monotonic_ns() / 1000000;
+}
+
+// Nomes das threads do manager, usados em MANAGER_CPUS e no comando threads
+static const char *const thread_names[] = {
+    "admin", "monitor", "connections", "snapshot", "delivery", "dispatch", "reader",
+};
+
+// Lê uma lista de CPUs no formato do taskset ("0-3,8,10-11"). Devolve -1 se for inválida.
+int parse_cpu_list(const char *list, cpu_set_t *cpus) {
+    const char *p = list;
+    CPU_ZERO(cpus);
+
+    while (*p) {
+        char *end;
+        long first = strtol(p, &end, 10);
+        if (end == p || first < 0 || first >= CPU_SETSIZE) {
+            return -1;
+        }
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            if (end == p + 1 || last < first || last >= CPU_SETSIZE) {
+                return -1;
+            }
+            p = end;
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            CPU_SET(cpu, cpus);
+        }
+        if (*p == ',') {
+            p++;
+        } else if (*p) {
+            return -1;
+        }
+    }
+    return CPU_COUNT(cpus) > 0 ? 0 : -1;
+}
+
+// Escreve o conjunto de CPUs no mesmo formato, agrupando os intervalos
+void format_cpu_list(const cpu_set_t *cpus, char *out, int out_len) {
+    int len = 0;
+    out[0] = '\0';
+    for (int cpu = 0; cpu < CPU_SETSIZE && len < out_len; cpu++) {
+        if (!CPU_ISSET(cpu, cpus)) {
+            continue;
+        }
+        int last = cpu;
+        while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, cpus)) {
+            last++;
+        }
+        len += snprintf(out + len, out_len - len, last > cpu ? "%s%d-%d" : "%s%d", len ? "," : "", cpu, last);
+        cpu = last;
+    }
+}
+
+// Nó NUMA de um CPU, a partir da ligação nodeN no sysfs. -1 se o sistema não indicar.
+int cpu_node(int cpu) {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+    DIR *dir = opendir(path);
+    if (!dir) {
+        return -1;
+    }
+
+    int node = -1;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strncmp(entry->d_name, "node", 4) == 0 && sscanf(entry->d_name + 4, "%d", &node) == 1) {
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+
+// Nós NUMA (um bit por nó) abrangidos por um conjunto de CPUs
+unsigned long long cpu_set_nodes(const cpu_set_t *cpus) {
+    unsigned long long nodes = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, cpus)) {
+            int node = cpu_node(cpu);
+            if (node >= 0 && node < 64) {
+                nodes |= 1ULL << node;
+            }
+        }
+    }
+    return nodes;
+}
+
+void format_node_list(unsigned long long nodes, char *out, int out_len) {
+    int len = 0;
+    out[0] = '\0';
+    for (int node = 0; node < 64 && len < out_len; node++) {
+        if (nodes & (1ULL << node)) {
+            len += snprintf(out + len, out_len - len, "%s%d", len ? "," : "", node);
+        }
+    }
+    if (len == 0) {
+        snprintf(out, out_len, "?");
+    }
+}
+
+// Lê MANAGER_CPUS: entradas "thread:cpus" separadas por espaços, por exemplo
+// "dispatch:2 delivery:3 *:0-1". A entrada "*" aplica-se às threads não indicadas.
+void load_cpu_config(ManagerState *state, const char *spec) {
+    char copy[512];
+    char *saveptr;
+    snprintf(copy, sizeof(copy), "%s", spec);
+
+    for (char *entry = strtok_r(copy, " ", &saveptr); entry; entry = strtok_r(NULL, " ", &saveptr)) {
+        char *colon = strchr(entry, ':');
+        CpuRule rule;
+        int known = 0;
+
+        if (colon) {
+            *colon = '\0';
+            known = strcmp(entry, "*") == 0;
+            for (size_t i = 0; i < sizeof(thread_names) / sizeof(thread_names[0]); i++) {
+                known |= strcmp(entry, thread_names[i]) == 0;
+            }
+        }
+        if (!known || state->cpu_rule_count >= MAX_THREADS + 1 || parse_cpu_list(colon + 1, &rule.cpus) != 0) {
+            fprintf(stderr, "Aviso: entrada '%s' de MANAGER_CPUS ignorada (threads: admin, monitor, connections, "
+                    "snapshot, delivery, dispatch, reader, *).\n", entry);
+            continue;
+        }
+        snprintf(rule.name, sizeof(rule.name), "%s", entry);
+        state->cpu_rules[state->cpu_rule_count++] = rule;
+    }
+}
+
+// Regra de MANAGER_CPUS para uma thread: a do seu nome ou, se não houver, a "*"
+const CpuRule *find_cpu_rule(const ManagerState *state, const char *name) {
+    const CpuRule *fallback = NULL;
+    for (int i = 0; i < state->cpu_rule_count; i++) {
+        if (strcmp(state->cpu_rules[i].name, name) == 0) {
+            return &state->cpu_rules[i];
+        }
+        if (strcmp(state->cpu_rules[i].name, "*") == 0) {
+            fallback = &state->cpu_rules[i];
+        }
+    }
+    return fallback;
+}
+
+// Mostra a colocação pedida e avisa se o despacho e a entrega ficarem em nós diferentes:
+// cada trama é escrita pela thread de despacho e lida pela de entrega, por isso entre nós
+// diferentes passa sempre pela interligação. A memória das filas não é ligada a nenhum nó.
+void report_cpu_placement(ManagerState *state) {
+    char cpus[128], nodes[64];
+    for (int i = 0; i < state->cpu_rule_count; i++) {
+        format_cpu_list(&state->cpu_rules[i].cpus, cpus, sizeof(cpus));
+        format_node_list(cpu_set_nodes(&state->cpu_rules[i].cpus), nodes, sizeof(nodes));
+        printf("Afinidade '%s': CPUs %s (nó %s)\n", state->cpu_rules[i].name, cpus, nodes);
+    }
+
+    const CpuRule *dispatch = find_cpu_rule(state, "dispatch");
+    const CpuRule *delivery = find_cpu_rule(state, "delivery");
+    if (dispatch && delivery) {
+        unsigned long long dispatch_nodes = cpu_set_nodes(&dispatch->cpus);
+        unsigned long long delivery_nodes = cpu_set_nodes(&delivery->cpus);
+        if (dispatch_nodes && delivery_nodes && (dispatch_nodes | delivery_nodes) != dispatch_nodes) {
+            fprintf(stderr, "Aviso: as threads de despacho e de entrega estão em nós NUMA diferentes; "
+                    "cada trama entregue passa de um nó para o outro.\n");
+        }
+    }
+}
+
+// Regista a thread que começa e aplica-lhe o nome e a afinidade pedida em MANAGER_CPUS.
+// Chamar no início de cada thread do manager.
+void thread_start(ManagerState *state, const char *name) {
+    char thread_name[16];
+    snprintf(thread_name, sizeof(thread_name), "mgr-%s", name);
+    pthread_setname_np(pthread_self(), thread_name);
+
+    const CpuRule *rule = find_cpu_rule(state, name);
+    if (rule) {
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(rule->cpus), &rule->cpus);
+        if (err != 0) {
+            char cpus[128];
+            format_cpu_list(&rule->cpus, cpus, sizeof(cpus));
+            fprintf(stderr, "Aviso: não foi possível fixar a thread '%s' nos CPUs %s: %s\n", name, cpus, strerror(err));
+        }
+    }
+
+    pthread_mutex_lock(&state->lock);
+    if (state->thread_count < MAX_THREADS) {
+        ThreadInfo *info = &state->threads[state->thread_count++];
+        snprintf(info->name, sizeof(info->name), "%s", name);
+        info->tid = (pid_t)syscall(SYS_gettid);
+    }
+    pthread_mutex_unlock(&state->lock);
+}
+
+// Lê os tempos de CPU, o último CPU usado e as trocas de contexto de uma thread.
+// Devolve -1 se a thread já terminou.
+int read_thread_stats(pid_t tid, ThreadStats *stats) {
+    char path[64], line[512];
+    snprintf(path, sizeof(path), "/proc/self/task/%d/stat", tid);
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return -1;
+    }
+    char *fields = fgets(line, sizeof(line), file) ? strrchr(line, ')') : NULL; // O nome pode ter espaços
+    fclose(file);
+    if (!fields) {
+        return -1;
+    }
+
+    // Depois do nome: estado (0), ..., utime (11), stime (12), ..., processor (36)
+    long ticks = sysconf(_SC_CLK_TCK);
+    char *saveptr;
+    int index = 0;
+    memset(stats, 0, sizeof(*stats));
+    for (char *token = strtok_r(fields + 1, " ", &saveptr); token; token = strtok_r(NULL, " ", &saveptr), index++) {
+        if (index == 11) {
+            stats->user_ms = strtod(token, NULL) * 1000.0 / ticks;
+        } else if (index == 12) {
+            stats->system_ms = strtod(token, NULL) * 1000.0 / ticks;
+        } else if (index == 36) {
+            stats->last_cpu = atoi(token);
+            break;
+        }
+    }
+
+    snprintf(path, sizeof(path), "/proc/self/task/%d/status", tid);
+    file = fopen(path, "r");
+    if (!file) {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), file)) {
+        sscanf(line, "voluntary_ctxt_switches: %ld", &stats->voluntary);
+        sscanf(line, "nonvoluntary_ctxt_switches: %ld", &stats->involuntary);
+    }
+    fclose(file);
+    return 0;
+}
+
+// Recompila os filtros dos subscritores sobre um único autómato para o tópico.
+// Chamar com state->lock adquirido, sempre que a lista de subscritores muda.
+void refresh_topic_filters(Topic *topic) {
+    char error[160];
+
+    matcher_reset(&topic->matcher);
+    topic->filtered = 0;
+    for (int i = 0; i < topic->sub_count; i++) {
+        if (filter_compile(topic->sub_filter[i], &topic->matcher, &topic->filters[i], error, sizeof(error)) != 0) {
+            printf("Aviso: Filtro de '%s' no tópico '%s' ignorado: %s\n", topic->subscribers[i]->username, topic->name, error);
+            filter_compile("", &topic->matcher, &topic->filters[i], error, sizeof(error));
+        }
+        topic->filtered |= topic->sub_filter[i][0] != '\0';
+    }
+
+    if (topic->matcher.pattern_count > 0 && matcher_build(&topic->matcher) != 0) {
+        perror("Erro ao construir filtros do tópico");
+    }
+}
+
+// Acrescenta um subscritor ao tópico. Chamar com state->lock adquirido.
+int add_subscriber(Topic *topic, Feed *feed, unsigned int last_seq, const char *filter) {
+    if (topic->sub_count >= MAX_FEEDS) {
+        return -1;
+    }
+    int index = topic->sub_count++;
+    topic->subscribers[index] = feed;
+    topic->sub_seq[index] = last_seq;
+    strncpy(topic->sub_filter[index], filter, MAX_FILTER_LEN - 1);
+    topic->sub_filter[index][MAX_FILTER_LEN - 1] = '\0';
+    topic->version++;
+    refresh_topic_filters(topic);
+    return index;
+}
+
+// Retira o subscritor na posição indicada (o último passa para o seu lugar)
+void remove_subscriber(Topic *topic, int index) {
+    int last = --topic->sub_count;
+    topic->subscribers[index] = topic->subscribers[last];
+    topic->sub_seq[index] = topic->sub_seq[last];
+    memcpy(topic->sub_filter[index], topic->sub_filter[last], MAX_FILTER_LEN);
+    topic->version++;
+    refresh_topic_filters(topic);
+}
+
+// Enfileira para o subscritor na posição indicada as mensagens retidas que ainda não
+// recebeu e que passam o seu filtro. Devolve quantas foram enviadas. Chamar com state->lock adquirido.
+int send_retained(ManagerState *state, Topic *topic, int index) {
+    Feed *feed = topic->subscribers[index];
+    int sent = 0;
+
+    for (int i = 0; i < topic->msg_count; i++) {
+        Message *stored = topic->messages[i];
+        if (stored->seq <= topic->sub_seq[index]) {
+            continue;
+        }
+        topic->sub_seq[index] = stored->seq;
+
+        Message raw;
+        message_copy(&raw, stored);
+        if (message_decompress(&raw) != 0) {
+            continue;
+        }
+
+        if (topic->sub_filter[index][0]) {
+            unsigned long long found, at_start;
+            matcher_scan(&topic->matcher, raw.body, raw.body_len, &found, &at_start);
+            if (!filter_match(&topic->filters[index], raw.username, raw.duration, found, at_start, 1)) {
+                continue;
+            }
+        }
+
+        enqueue_for_feed(state, feed, feed->accepts_compressed ? stored : &raw);
+        sent++;
+    }
+    return sent;
+}
+
+// Abre o pipe do feed sem bloquear. Falha com ENXIO se o feed ainda não o abriu para leitura.
+int open_feed_pipe(const char *pipe_name) {
+    // O pipe continua não bloqueante: um feed lento não pode parar a thread de entrega
+    return open(pipe_name, O_WRONLY | O_NONBLOCK);
+}
+
+// Envia uma resposta do sistema diretamente para um pipe (ACK ou ERROR)
+void send_system_reply(int fd, Opcode opcode, ErrorCode error, const char *body) {
+    Message reply = {0};
+    protocol_set_action(&reply, opcode);
+    reply.error = error;
+    strncpy(reply.username, "SYSTEM", sizeof(reply.username));
+    if (body) {
+        message_set_body(&reply, body);
+    }
+
+    if (protocol_write_frame(fd, &reply) == -1) {
+        perror("Erro ao enviar resposta ao feed");
+    }
+}
+
+// Regista um feed cujo pipe já está aberto. Chamar com state->lock adquirido.
+int attach_feed(ManagerState *state, const char *username, const char *pipe_name, int flags, int fd) {
+    if (state->feed_count >= MAX_FEEDS) {
+        send_system_reply(fd, OP_ERROR, ERR_FEED_LIMIT, "Erro: Limite de feeds atingido.");
+        close(fd);
+        return -1;
+    }
+
+    Feed *feed = &state->feeds[state->feed_count];
+    memset(feed, 0, sizeof(*feed));
+    strncpy(feed->username, username, sizeof(feed->username));
+    strncpy(feed->pipe_name, pipe_name, sizeof(feed->pipe_name));
+    feed->pipe_fd = fd;
+    feed->accepts_compressed = (flags & FRAME_ACCEPTS_COMPRESSED) != 0;
+    state->feed_count++;
+
+    // Retomar a sessão do feed: repor as subscrições e reenviar as mensagens retidas em falta
+    int resumed = 0, missed = 0;
+    for (int i = 0; i < state->topic_count; i++) {
+        Topic *topic = &state->topics[i];
+        for (int j = 0; j < topic->session_count; j++) {
+            if (strcmp(topic->sessions[j].username, username) == 0 && topic->sub_count < MAX_FEEDS) {
+                int index = add_subscriber(topic, feed, topic->sessions[j].last_seq, topic->sessions[j].filter);
+                missed += send_retained(state, topic, index);
+                topic->sessions[j] = topic->sessions[--topic->session_count];
+                topic->version++;
+                resumed++;
+                break;
+            }
+        }
+    }
+
+    if (resumed > 0) {
+        char summary[100];
+        snprintf(summary, sizeof(summary), "Sessão retomada: %d subscrições, %d mensagens em falta.", resumed, missed);
+        printf("Feed '%s': %s\n", username, summary);
+        send_system_reply(fd, OP_ACK, ERR_NONE, summary);
+    } else {
+        send_system_reply(fd, OP_ACK, ERR_NONE, NULL);
+    }
+    return 0;
+}
+
+// Guarda a sessão de um feed que deixou de estar ligado ao tópico. Chamar com state->lock adquirido.
+void save_session(Topic *topic, const char *username, unsigned int last_seq, const char *filter, int tick) {
+    if (topic->session_count >= MAX_FEEDS) {
+        printf("Aviso: Sem espaço para guardar a sessão de '%s' no tópico '%s'.\n", username, topic->name);
+        return;
+    }
+    TopicSession *session = &topic->sessions[topic->session_count++];
+    strncpy(session->username, username, sizeof(session->username));
+    session->last_seq = last_seq;
+    strncpy(session->filter, filter, sizeof(session->filter));
+    session->saved_tick = tick;
+    topic->version++;
+}
+
+// Última mensagem do tópico que chegou de facto ao pipe do feed: as que ainda
+// estão na fila de entrega não contam. Chamar com state->lock adquirido.
+unsigned int delivered_seq(Feed *feed, const char *topic_name, unsigned int seq) {
+    for (int qos = 0; qos < QOS_COUNT; qos++) {
+        FrameQueue *queue = &feed->out[qos];
+        for (int k = 0; k < queue->count; k++) {
+            Message *frame = queue->frames[(queue->head + k) % QUEUE_CAPACITY];
+            if (frame->seq > 0 && frame->seq <= seq && strcmp(frame->topic, topic_name) == 0) {
+                seq = frame->seq - 1;
+            }
+        }
+    }
+    return seq;
+}
+
+// Esquece o balde herdado de "*" de um utilizador ou tópico que deixou de existir.
+// Chamar com state->lock adquirido.
+void drop_inherited_limit(ManagerState *state, int kind, const char *name) {
+    for (int i = 0; i < state->inherited_count; i++) {
+        RateLimit *limit = &state->inherited_limits[i];
+        if (limit->kind == kind && strcmp(limit->name, name) == 0) {
+            *limit = state->inherited_limits[--state->inherited_count];
+            return;
+        }
+    }
+}
+
+// Retira o feed na posição indicada. As subscrições ficam guardadas como sessão.
+// Chamar com state->lock adquirido.
+void detach_feed(ManagerState *state, int index) {
+    Feed *feed = &state->feeds[index];
+    Feed *last = &state->feeds[state->feed_count - 1];
+
+    // Passar as subscrições do feed para sessões e corrigir os ponteiros do feed que muda de posição
+    for (int i = 0; i < state->topic_count; i++) {
+        Topic *topic = &state->topics[i];
+        for (int j = 0; j < topic->sub_count; j++) {
+            if (topic->subscribers[j] == feed) {
+                save_session(topic, feed->username, delivered_seq(feed, topic->name, topic->sub_seq[j]), topic->sub_filter[j], state->ticks);
+                remove_subscriber(topic, j);
+                j--;
+            } else if (topic->subscribers[j] == last) {
+                topic->subscribers[j] = feed;
+            }
+        }
+    }
+
+    for (int qos = 0; qos < QOS_COUNT; qos++) {
+        queue_clear(&state->feeds[index].out[qos]);
+    }
+    close(state->feeds[index].pipe_fd);
+    drop_inherited_limit(state, LIMIT_USER, state->feeds[index].username);
+    if (!state->replay) {
+        unlink(state->feeds[index].pipe_name);
+    }
+
+    state->feeds[index] = state->feeds[state->feed_count - 1];
+    state->feed_count--;
+}
+
+// Recusa uma ligação cujo feed ainda não abriu o pipe. O pipe é aberto também para leitura
+// (assim não espera pelo feed) e o descritor fica aberto até CONNECT_TIMEOUT_MS: fechar o
+// último descritor antes de o feed abrir o pipe descartaria a resposta. Chamar com state->lock adquirido.
+void reject_pending_feed(ManagerState *state, const char *pipe_name, const char *reason) {
+    int fd = open(pipe_name, O_RDWR | O_NONBLOCK);
+    if (fd == -1) {
+        perror("Erro ao abrir pipe exclusivo do feed");
+        return;
+    }
+    send_system_reply(fd, OP_ERROR, ERR_FEED_LIMIT, reason);
+
+    // Tempestade de ligações: a recusa mais antiga deixa de ser segurada
+    if (state->rejected_count == MAX_PENDING) {
+        close(state->rejected[0].fd);
+        memmove(&state->rejected[0], &state->rejected[1], (MAX_PENDING - 1) * sizeof(RejectedFeed));
+        state->rejected_count--;
+    }
+    state->rejected[state->rejected_count++] = (RejectedFeed){fd, monotonic_ms() + CONNECT_TIMEOUT_MS};
+}
+
+// Devolve 0 se o feed ficou ligado, 1 se a ligação ficou pendente e -1 em caso de erro
+int add_feed(ManagerState *state, const char *username, const char *pipe_name, int flags) {
+    pthread_mutex_lock(&state->lock);
+
+    // Na reprodução de uma gravação os feeds não existem: as entregas vão para /dev/null
+    int fd = state->replay ? open("/dev/null", O_WRONLY) : open_feed_pipe(pipe_name);
+    if (fd != -1) {
+        int result = attach_feed(state, username, pipe_name, flags, fd);
+        pthread_mutex_unlock(&state->lock);
+        return result;
+    }
+
+    if (errno != ENXIO) {
+        perror("Erro ao abrir pipe exclusivo do feed");
+        pthread_mutex_unlock(&state->lock);
+        return -1;
+    }
+
+    // O feed ainda não abriu o pipe: a thread de ligações volta a tentar até ao prazo
+    if (state->feed_count + state->pending_count >= MAX_FEEDS || state->pending_count >= MAX_PENDING) {
+        reject_pending_feed(state, pipe_name, state->pending_count >= MAX_PENDING ?
+                            "Erro: Demasiadas ligações pendentes." : "Erro: Limite de feeds atingido.");
+        pthread_mutex_unlock(&state->lock);
+        return -1;
+    }
+
+    PendingFeed *pending = &state->pending[state->pending_count++];
+    strncpy(pending->username, username, sizeof(pending->username));
+    strncpy(pending->pipe_name, pipe_name, sizeof(pending->pipe_name));
+    pending->flags = flags;
+    pending->deadline_ms = monotonic_ms() + CONNECT_TIMEOUT_MS;
+
+    pthread_mutex_unlock(&state->lock);
+    return 1;
+}
+
+void remove_feed(ManagerState *state, const char *username) {
+    pthread_mutex_lock(&state->lock);
+
+    for (int i = 0; i < state->feed_count; i++) {
+        if (strcmp(state->feeds[i].username, username) == 0) {
+            detach_feed(state, i);
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&state->lock);
+}
+
+// Regista a remoção de um tópico para o próximo snapshot. Chamar com state->lock adquirido.
+void record_topic_removal(ManagerState *state, const char *name) {
+    if (state->removed_count >= MAX_TOPICS) {
+        state->snapshot_full = 1; // Demasiadas remoções: reescrever o diário por inteiro
+        return;
+    }
+    strncpy(state->removed_topics[state->removed_count++], name, MAX_TOPIC_NAME);
+}
+
+// Entra numa secção de leitura sem lock. reader é a entrada da thread (RCU_ADMIN ou
+// RCU_DISPATCH); a secção não pode esperar por state->lock.
+void rcu_read_lock(ManagerState *state, int reader) {
+    __atomic_store_n(&state->rcu_active[reader], __atomic_load_n(&state->rcu_epoch, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+}
+
+void rcu_read_unlock(ManagerState *state, int reader) {
+    __atomic_store_n(&state->rcu_active[reader], 0, __ATOMIC_RELEASE);
+}
+
+// Liberta os objetos retirados que nenhum leitor ativo pode ainda estar a ver: um leitor
+// que entrou numa época anterior à da retirada pode ter lido o ponteiro antigo.
+// Chamar com state->lock adquirido.
+void rcu_reclaim(ManagerState *state) {
+    unsigned long long oldest = 0;
+    for (int i = 0; i < RCU_READERS; i++) {
+        unsigned long long epoch = __atomic_load_n(&state->rcu_active[i], __ATOMIC_SEQ_CST);
+        if (epoch && (!oldest || epoch < oldest)) {
+            oldest = epoch;
+        }
+    }
+
+    int kept = 0;
+    for (int i = 0; i < state->retired_count; i++) {
+        if (!oldest || state->retired_epoch[i] <= oldest) {
+            free(state->retired[i]);
+        } else {
+            state->retired[kept] = state->retired[i];
+            state->retired_epoch[kept++] = state->retired_epoch[i];
+        }
+    }
+    state->retired_count = kept;
+}
+
+// Retira um objeto que deixou de estar publicado. Chamar com state->lock adquirido,
+// depois de o ponteiro publicado já não o referir.
+void rcu_retire(ManagerState *state, void *ptr) {
+    unsigned long long epoch = __atomic_add_fetch(&state->rcu_epoch, 1, __ATOMIC_SEQ_CST);
+    rcu_reclaim(state);
+
+    // Lista cheia: as secções de leitura são curtas, esperar que terminem
+    while (state->retired_count >= RCU_MAX_RETIRED) {
+        sched_yield();
+        rcu_reclaim(state);
+    }
+    state->retired[state->retired_count] = ptr;
+    state->retired_epoch[state->retired_count++] = epoch;
+    rcu_reclaim(state);
+}
+
+// Publica um novo diretório com os tópicos atuais. Chamar com state->lock adquirido.
+// Devolve -1 se faltar memória (o diretório anterior continua publicado).
+int publish_topic_dir(ManagerState *state) {
+    TopicDir *dir = malloc(sizeof(TopicDir) + sizeof(TopicDirEntry) * state->topic_count);
+    if (!dir) {
+        perror("Erro ao publicar diretório de tópicos");
+        return -1;
+    }
+
+    dir->count = state->topic_count;
+    for (int i = 0; i < state->topic_count; i++) {
+        memcpy(dir->entries[i].name, state->topics[i].name, MAX_TOPIC_NAME);
+        dir->entries[i].flags = state->topics[i].flags;
+    }
+
+    TopicDir *old = __atomic_exchange_n(&state->topic_dir, dir, __ATOMIC_SEQ_CST);
+    if (old) {
+        rcu_retire(state, old);
+    }
+    return 0;
+}
+
+// Flags de um tópico a partir do diretório publicado. Chamar dentro de uma secção de leitura.
+TopicFlags *lookup_topic_flags(ManagerState *state, const char *name) {
+    TopicDir *dir = __atomic_load_n(&state->topic_dir, __ATOMIC_SEQ_CST);
+    for (int i = 0; dir && i < dir->count; i++) {
+        if (strcmp(dir->entries[i].name, name) == 0) {
+            return dir->entries[i].flags;
+        }
+    }
+    return NULL;
+}
+
+int topic_is_locked(const Topic *topic) {
+    return __atomic_load_n(&topic->flags->locked, __ATOMIC_ACQUIRE);
+}
+
+// Remove o tópico da posição index, com as suas mensagens. Chamar com state->lock adquirido.
+void destroy_topic(ManagerState *state, int index) {
+    Topic *topic = &state->topics[index];
+    for (int k = 0; k < topic->msg_count; k++) {
+        free(topic->messages[k]);
+    }
+    matcher_reset(&topic->matcher);
+    free(topic->fanout_hist);
+    drop_inherited_limit(state, LIMIT_TOPIC, topic->name);
+    TopicFlags *flags = topic->flags;
+
+    *topic = state->topics[--state->topic_count];
+
+    // As flags só podem ser libertadas quando o diretório publicado já não as referir
+    if (publish_topic_dir(state) == 0) {
+        rcu_retire(state, flags);
+    }
+}
+
+Topic *get_or_create_topic(ManagerState *state, const char *name) {
+    for (int i = 0; i < state->topic_count; i++) {
+        if (strcmp(state->topics[i].name, name) == 0) {
+            return &state->topics[i];
+        }
+    }
+
+    if (state->topic_count >= MAX_TOPICS) {
+        return NULL; // Limite de tópicos atingido
+    }
+
+    TopicFlags *flags = calloc(1, sizeof(TopicFlags));
+    if (!flags) {
+        return NULL;
+    }
+
+    Topic *topic = &state->topics[state->topic_count];
+    memset(topic, 0, sizeof(*topic));
+    strncpy(topic->name, name, MAX_TOPIC_NAME);
+    topic->flags = flags;
+    topic->version = 1;
+    state->topic_count++;
+    publish_topic_dir(state);
+
+    return topic;
+}
+
+Topic *find_topic(ManagerState *state, const char *name) {
+    for (int i = 0; i < state->topic_count; i++) {
+        if (strcmp(state->topics[i].name, name) == 0) {
+            return &state->topics[i];
+        }
+    }
+    return NULL;
+}
+
+// Envia uma mensagem de erro ao feed indicado. Chamar com state->lock adquirido.
+void notify_feed_error(ManagerState *state, const char *username, ErrorCode error, const char *fmt, const char *arg) {
+    for (int i = 0; i < state->feed_count; i++) {
+        if (strcmp(state->feeds[i].username, username) == 0) {
+            Message error_msg = {0};
+            protocol_set_action(&error_msg, OP_ERROR);
+            strncpy(error_msg.username, "SYSTEM", sizeof(error_msg.username));
+            error_msg.error = error;
+            error_msg.priority = QOS_CONTROL;
+            message_format_body(&error_msg, fmt, arg);
+
+            enqueue_for_feed(state, &state->feeds[i], &error_msg);
+            break;
+        }
+    }
+}
+
+// Subscreve o feed ao tópico, opcionalmente com um filtro (ver filter.h). Subscrever de
+// novo um tópico já subscrito substitui o filtro.
+void subscribe_feed_to_topic(ManagerState *state, const char *username, const char *topic_name, const char *filter) {
+    pthread_mutex_lock(&state->lock);
+
+    // Validar o filtro contra os padrões que o tópico já tem
+    Matcher scratch = {0};
+    Filter compiled;
+    char error[160];
+    Topic *existing = find_topic(state, topic_name);
+    if (existing) {
+        scratch.pattern_count = existing->matcher.pattern_count;
+        memcpy(scratch.patterns, existing->matcher.patterns, sizeof(scratch.patterns));
+        memcpy(scratch.pattern_len, existing->matcher.pattern_len, sizeof(scratch.pattern_len));
+    }
+    if (filter_compile(filter, &scratch, &compiled, error, sizeof(error)) != 0) {
+        printf("Erro: Filtro inválido de '%s' no tópico '%s': %s\n", username, topic_name, error);
+        notify_feed_error(state, username, ERR_BAD_FILTER, "Erro: Filtro inválido: %s", error);
+        pthread_mutex_unlock(&state->lock);
+        return;
+    }
+
+    Topic *topic = get_or_create_topic(state, topic_name);
+    if (!topic) {
+        printf("Erro: Limite de tópicos atingido ou falha ao criar tópico.\n");
+        pthread_mutex_unlock(&state->lock);
+        return;
+    }
+
+    for (int j = 0; j < topic->sub_count; j++) {
+        if (strcmp(topic->subscribers[j]->username, username) == 0) {
+            strncpy(topic->sub_filter[j], filter, MAX_FILTER_LEN - 1);
+            topic->version++;
+            refresh_topic_filters(topic);
+            printf("Filtro de '%s' no tópico '%s' atualizado: %s\n", username, topic_name, filter[0] ? filter : "(nenhum)");
+            pthread_mutex_unlock(&state->lock);
+            return;
+        }
+    }
+
+    for (int i = 0; i < state->feed_count; i++) {
+        if (strcmp(state->feeds[i].username, username) == 0) {
+            if (add_subscriber(topic, &state->feeds[i], topic->last_seq, filter) >= 0) {
+                if (filter[0]) {
+                    printf("Feed '%s' subscrito ao tópico '%s' com filtro: %s\n", username, topic_name, filter);
+                } else {
+                    printf("Feed '%s' subscrito ao tópico '%s'.\n", username, topic_name);
+                }
+            } else {
+                printf("Erro: Limite de subscritores no tópico '%s'.\n", topic_name);
+            }
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&state->lock);
+}
+
+// Remove um feed de um tópico
+void unsubscribe_feed_from_topic(ManagerState *state, const char *username, const char *topic_name) {
+    pthread_mutex_lock(&state->lock);
+
+    for (int i = 0; i < state->topic_count; i++) {
+        if (strcmp(state->topics[i].name, topic_name) == 0) {
+            Topic *topic = &state->topics[i];
+
+            for (int j = 0; j < topic->sub_count; j++) {
+                if (strcmp(topic->subscribers[j]->username, username) == 0) {
+                    // Remover subscrição
+                    remove_subscriber(topic, j);
+                    printf("Feed '%s' cancelou subscrição do tópico '%s'.\n", username, topic_name);
+
+                    // Remover o tópico se não houver subscritores
+                    if (topic->sub_count == 0 && topic->session_count == 0) {
+                        record_topic_removal(state, topic->name);
+                        destroy_topic(state, i);
+                        printf("Tópico '%s' removido (sem subscritores).\n", topic_name);
+                    }
+
+                    pthread_mutex_unlock(&state->lock);
+                    return;
+                }
+            }
+
+            printf("Feed '%s' não está subscrito ao tópico '%s'.\n", username, topic_name);
+        }
+    }
+
+    printf("Tópico '%s' não encontrado.\n", topic_name);
+    pthread_mutex_unlock(&state->lock);
+}
+
+ActiveStream *find_stream(ManagerState *state, const char *username, unsigned int stream_id) {
+    for (int i = 0; i < state->stream_count; i++) {
+        if (state->streams[i].stream_id == stream_id && strcmp(state->streams[i].username, username) == 0) {
+            return &state->streams[i];
+        }
+    }
+    return NULL;
+}
+
+void end_stream(ManagerState *state, ActiveStream *stream) {
+    *stream = state->streams[state->stream_count - 1];
+    state->stream_count--;
+}
+
+// Entrega uma trama a todos os subscritores do tópico. Chamar com state->lock adquirido.
+void deliver_to_subscribers(ManagerState *state, Topic *topic, const Message *msg) {
+    // Corpo original e, se o tópico o pedir, a versão comprimida (calculada uma vez)
+    Message raw;
+    message_copy(&raw, msg);
+    if (message_decompress(&raw) != 0) {
+        printf("Erro: Corpo comprimido inválido de '%s'.\n", msg->username);
+        return;
+    }
+
+    // Cada mensagem inteira recebe o número de sequência seguinte do tópico
+    raw.seq = (raw.flags & FRAME_CHUNK) ? 0 : ++topic->last_seq;
+    if (raw.flags & FRAME_TRACED) {
+        raw.t_fanout = monotonic_ns();
+    }
+
+    Message packed = raw;
+    int has_packed = 0;
+    if (topic->compress == COMPRESS_LZ) {
+        long long start = monotonic_ns();
+        has_packed = message_compress(&packed);
+        topic->codec_ns += monotonic_ns() - start;
+    }
+
+    // Guardar mensagens persistentes (comprimidas quando compensa). Mensagens longas não ficam retidas.
+    if (raw.duration > 0 && !(raw.flags & FRAME_CHUNK) && topic->msg_count < 5) {
+        Message *stored = message_clone(has_packed ? &packed : &raw);
+        if (stored) {
+            // Adicionar o tempo relativo
+            stored->created_time = state->ticks;
+            stored->flags &= ~FRAME_TRACED; // As marcas temporais não valem para reenvios
+            topic->messages[topic->msg_count++] = stored;
+            topic->version++;
+        }
+    }
+
+    // Avaliar todos os filtros do tópico com uma só passagem pelo corpo. O conteúdo
+    // dos blocos de mensagens longas não é analisado: só passam filtros sem termos de conteúdo.
+    unsigned long long found = 0, at_start = 0;
+    int has_body = !(raw.flags & FRAME_CHUNK);
+    if (topic->filtered && has_body) {
+        matcher_scan(&topic->matcher, raw.body, raw.body_len, &found, &at_start);
+    }
+
+    // Enfileirar a mensagem para todos os subscritores, na classe com que chegou
+    for (int i = 0; i < topic->sub_count; i++) {
+        Feed *feed = topic->subscribers[i];
+        const Message *out = (has_packed && feed->accepts_compressed) ? &packed : &raw;
+
+        if (topic->sub_filter[i][0] &&
+            !filter_match(&topic->filters[i], raw.username, raw.duration, found, at_start, has_body)) {
+            topic->filtered_out++;
+            continue;
+        }
+
+        enqueue_for_feed(state, feed, out);
+        if (raw.seq > 0) {
+            topic->sub_seq[i] = raw.seq;
+        }
+        topic->bytes_raw += raw.body_len;
+        topic->bytes_out += out->body_len;
+    }
+}
+
+// Consome um token do balde. Devolve 1 se havia token disponível.
+int bucket_take(TokenBucket *bucket, long long now_ns) {
+    if (bucket->rate <= 0) {
+        return 1; // Sem limite
+    }
+
+    bucket->tokens += (now_ns - bucket->last_ns) / 1e9 * bucket->rate;
+    if (bucket->tokens > bucket->burst) {
+        bucket->tokens = bucket->burst;
+    }
+    bucket->last_ns = now_ns;
+
+    if (bucket->tokens >= 1.0) {
+        bucket->tokens -= 1.0;
+        return 1;
+    }
+    return 0;
+}
+
+// Limite aplicável a um utilizador ou tópico. Quem não tem limite próprio recebe um balde
+// seu, copiado do limite "*" e guardado à parte dos limites definidos pelo administrador;
+// com a tabela cheia é reaproveitado o balde usado há mais tempo. Devolve NULL se não houver limite.
+RateLimit *find_limit(ManagerState *state, int kind, const char *name) {
+    RateLimit *fallback = NULL;
+    for (int i = 0; i < state->limit_count; i++) {
+        RateLimit *limit = &state->limits[i];
+        if (limit->kind != kind) continue;
+        if (strcmp(limit->name, name) == 0) return limit;
+        if (strcmp(limit->name, "*") == 0) fallback = limit;
+    }
+    if (!fallback) {
+        return NULL;
+    }
+
+    for (int i = 0; i < state->inherited_count; i++) {
+        RateLimit *limit = &state->inherited_limits[i];
+        if (limit->kind == kind && strcmp(limit->name, name) == 0) return limit;
+    }
+
+    RateLimit *limit;
+    if (state->inherited_count < MAX_INHERITED_LIMITS) {
+        limit = &state->inherited_limits[state->inherited_count++];
+    } else {
+        limit = &state->inherited_limits[0];
+        for (int i = 1; i < MAX_INHERITED_LIMITS; i++) {
+            if (state->inherited_limits[i].bucket.last_ns < limit->bucket.last_ns) {
+                limit = &state->inherited_limits[i];
+            }
+        }
+    }
+
+    *limit = *fallback;
+    memset(limit->name, 0, sizeof(limit->name));
+    strncpy(limit->name, name, sizeof(limit->name) - 1);
+    limit->inherited = 1;
+    limit->bucket.tokens = limit->bucket.burst;
+    limit->bucket.last_ns = monotonic_ns();
+    limit->rejected = 0;
+    limit->last_notice_ns = 0;
+    return limit;
+}
+
+// Avisa o feed de que uma mensagem sua foi descartada por sobrecarga, no máximo uma vez
+// por intervalo. Chamar com state->lock adquirido.
+void notify_overload(ManagerState *state, const Message *msg) {
+    for (int i = 0; i < state->feed_count; i++) {
+        Feed *feed = &state->feeds[i];
+        if (strcmp(feed->username, msg->username) != 0) {
+            continue;
+        }
+
+        // A rejeição de uma mensagem longa é sempre avisada: só acontece uma vez por transferência
+        long long now = monotonic_ns();
+        if ((msg->flags & FRAME_CHUNK) || now - feed->overload_notice_ns >= LIMIT_NOTICE_NS) {
+            feed->overload_notice_ns = now;
+            notify_feed_error(state, msg->username, ERR_OVERLOAD,
+                              (msg->flags & FRAME_CHUNK) ? "Erro: Manager sobrecarregado. Mensagem longa rejeitada no tópico '%s'."
+                                                         : "Erro: Manager sobrecarregado. Mensagem rejeitada no tópico '%s'.",
+                              msg->topic);
+        }
+        return;
+    }
+}
+
+// Mensagem longa rejeitada por sobrecarga a que a trama pertence, ou NULL. Chamar com
+// state->queue_lock adquirido.
+ShedStream *find_shed_stream(ManagerState *state, const Message *msg) {
+    if (!(msg->flags & FRAME_CHUNK)) {
+        return NULL;
+    }
+
+    for (int i = 0; i < state->shed_stream_count; i++) {
+        ShedStream *shed = &state->shed_streams[i];
+        if (shed->stream_id == msg->stream_id && strcmp(shed->username, msg->username) == 0) {
+            return shed;
+        }
+    }
+    return NULL;
+}
+
+// Regista o descarte de uma trama por sobrecarga. Um bloco perdido rejeita a mensagem longa
+// inteira: os blocos seguintes já não chegam à fila e, se o primeiro ainda lá estiver, é
+// descartado no despacho. Chamar com state->queue_lock adquirido.
+void shed_frame(ManagerState *state, const Message *msg) {
+    state->shed_count++;
+    if (!(msg->flags & FRAME_CHUNK) || find_shed_stream(state, msg)) {
+        return;
+    }
+
+    ShedStream *shed;
+    if (state->shed_stream_count < MAX_SHED_STREAMS) {
+        shed = &state->shed_streams[state->shed_stream_count++];
+    } else {
+        shed = &state->shed_streams[state->shed_stream_next];
+        state->shed_stream_next = (state->shed_stream_next + 1) % MAX_SHED_STREAMS;
+    }
+    strncpy(shed->username, msg->username, sizeof(shed->username));
+    shed->stream_id = msg->stream_id;
+}
+
+// Admissão de uma mensagem nova: sobrecarga da fila da sua classe e limites por utilizador
+// e por tópico. Os comandos de controlo (INIT, EXIT, SUB, UNSUB) nunca passam por aqui.
+ErrorCode admit_message(ManagerState *state, const Message *msg) {
+    // Sob sobrecarga descartam-se primeiro as mensagens sem retenção e as mensagens longas,
+    // e em sobrecarga crítica todas as mensagens da classe. Cada classe tem a sua fila,
+    // por isso uma inundação de BULK não faz descartar mensagens URGENT.
+    pthread_mutex_lock(&state->queue_lock);
+    int load_pct = 100 * state->inbound[msg->priority].count / QUEUE_CAPACITY;
+    int retained = msg->duration > 0 && !(msg->flags & FRAME_CHUNK);
+    if (load_pct >= OVERLOAD_CRITICAL_PCT || (load_pct >= OVERLOAD_HIGH_PCT && !retained)) {
+        shed_frame(state, msg);
+        pthread_mutex_unlock(&state->queue_lock);
+        notify_overload(state, msg);
+        return ERR_OVERLOAD;
+    }
+    pthread_mutex_unlock(&state->queue_lock);
+
+    long long now = monotonic_ns();
+    RateLimit *limits[2] = {
+        find_limit(state, LIMIT_USER, msg->username),
+        find_limit(state, LIMIT_TOPIC, msg->topic),
+    };
+
+    for (int i = 0; i < 2; i++) {
+        RateLimit *limit = limits[i];
+        if (!limit || bucket_take(&limit->bucket, now)) {
+            continue;
+        }
+
+        limit->rejected++;
+        ErrorCode error = limit->kind == LIMIT_USER ? ERR_RATE_USER : ERR_RATE_TOPIC;
+
+        // Avisar o feed no máximo uma vez por intervalo, para o aviso não se tornar ele próprio uma inundação
+        if (now - limit->last_notice_ns >= LIMIT_NOTICE_NS) {
+            limit->last_notice_ns = now;
+            notify_feed_error(state, msg->username, error,
+                              error == ERR_RATE_USER ? "Erro: Limite de envio do utilizador '%s' excedido."
+                                                     : "Erro: Limite de envio do tópico '%s' excedido.",
+                              limit->name);
+        }
+        return error;
+    }
+
+    return ERR_NONE;
+}
+
+// Blocos seguintes de uma mensagem longa: seguem logo para os subscritores, sem acumular
+void process_stream_chunk(ManagerState *state, const Message *msg) {
+    ActiveStream *stream = find_stream(state, msg->username, msg->stream_id);
+    if (!stream) {
+        return; // Transferência rejeitada no primeiro bloco ou expirada
+    }
+
+    Topic *topic = find_topic(state, stream->topic);
+    if (!topic) {
+        end_stream(state, stream);
+        return;
+    }
+
+    stream->last_ms = monotonic_ms();
+    deliver_to_subscribers(state, topic, msg);
+
+    if (msg->flags & FRAME_LAST) {
+        printf("Mensagem longa #%u de '%s' concluída no tópico '%s'.\n", msg->stream_id, msg->username, topic->name);
+        end_stream(state, stream);
+    }
+}
+
+// Fecha a meio uma mensagem longa que perdeu um bloco por sobrecarga: os subscritores recebem
+// um último bloco vazio e descartam o que já tinham recebido. Chamar com state->lock adquirido.
+void abort_stream(ManagerState *state, ActiveStream *stream, const Message *msg) {
+    Topic *topic = find_topic(state, stream->topic);
+    if (topic) {
+        Message last;
+        memcpy(&last, msg, FRAME_HEADER_SIZE);
+        last.flags = FRAME_CHUNK | FRAME_LAST;
+        last.body_len = 0;
+        last.raw_len = 0;
+        last.body[0] = '\0';
+        deliver_to_subscribers(state, topic, &last);
+    }
+
+    printf("Mensagem longa #%u de '%s' rejeitada por sobrecarga.\n", stream->stream_id, stream->username);
+    end_stream(state, stream);
+}
+
+void process_message(ManagerState *state, const Message *msg) {
+    // Verificar se o tópico está bloqueado, sem o lock global: o administrador altera o
+    // bloqueio com uma escrita atómica e não atrasa a publicação nos outros tópicos
+    if (!((msg->flags & FRAME_CHUNK) && msg->stream_offset > 0)) {
+        rcu_read_lock(state, RCU_DISPATCH);
+        TopicFlags *flags = lookup_topic_flags(state, msg->topic);
+        int locked = flags && __atomic_load_n(&flags->locked, __ATOMIC_ACQUIRE);
+        rcu_read_unlock(state, RCU_DISPATCH);
+
+        if (locked) {
+            printf("Erro: Tópico '%s' está bloqueado. Mensagem rejeitada.\n", msg->topic);
+
+            // Notificar o feed enviador
+            pthread_mutex_lock(&state->lock);
+            notify_feed_error(state, msg->username, ERR_TOPIC_LOCKED, "Erro: Tópico '%s' está bloqueado. Mensagem rejeitada.", msg->topic);
+            pthread_mutex_unlock(&state->lock);
+            return;
+        }
+    }
+
+    pthread_mutex_lock(&state->lock);
+
+    if ((msg->flags & FRAME_CHUNK) && msg->stream_offset > 0) {
+        process_stream_chunk(state, msg);
+        pthread_mutex_unlock(&state->lock);
+        return;
+    }
+
+    // Obter o tópico
+    Topic *topic = find_topic(state, msg->topic);
+    if (!topic) {
+        printf("Erro: Tópico '%s' não encontrado.\n", msg->topic);
+        pthread_mutex_unlock(&state->lock);
+        return;
+    }
+
+    // Verificar se o feed está subscrito ao tópico
+    int is_subscribed = 0;
+    for (int i = 0; i < topic->sub_count; i++) {
+        if (strcmp(topic->subscribers[i]->username, msg->username) == 0) {
+            is_subscribed = 1;
+            break;
+        }
+    }
+
+    if (!is_subscribed) {
+        printf("Erro: Feed '%s' tentou enviar mensagem ao tópico '%s' sem estar subscrito.\n", msg->username, msg->topic);
+
+        // Notificar o feed enviador
+        notify_feed_error(state, msg->username, ERR_NOT_SUBSCRIBED, "Erro: Não subscrito ao tópico '%s'. Mensagem rejeitada.", msg->topic);
+        pthread_mutex_unlock(&state->lock);
+        return;
+    }
+
+    // Controlo de admissão (uma mensagem longa conta uma vez, no primeiro bloco)
+    if (admit_message(state, msg) != ERR_NONE) {
+        pthread_mutex_unlock(&state->lock);
+        return;
+    }
+
+    // Primeiro bloco de uma mensagem longa: registar a transferência, a não ser que um
+    // dos blocos seguintes já tenha sido descartado por sobrecarga
+    if (msg->flags & FRAME_CHUNK) {
+        pthread_mutex_lock(&state->queue_lock);
+        int shed = find_shed_stream(state, msg) != NULL;
+        pthread_mutex_unlock(&state->queue_lock);
+        if (shed) {
+            printf("Mensagem longa #%u de '%s' rejeitada por sobrecarga.\n", msg->stream_id, msg->username);
+            pthread_mutex_unlock(&state->lock);
+            return;
+        }
+
+        if (msg->stream_total > MAX_STREAM_LEN || state->stream_count >= MAX_STREAMS) {
+            notify_feed_error(state, msg->username, ERR_STREAM_REJECTED, "Erro: Mensagem longa rejeitada no tópico '%s'.", msg->topic);
+            pthread_mutex_unlock(&state->lock);
+            return;
+        }
+
+        if (!(msg->flags & FRAME_LAST)) {
+            ActiveStream *stream = &state->streams[state->stream_count++];
+            strncpy(stream->username, msg->username, sizeof(stream->username));
+            strncpy(stream->topic, topic->name, sizeof(stream->topic));
+            stream->stream_id = msg->stream_id;
+            stream->last_ms = monotonic_ms();
+        }
+
+        printf("Mensagem longa #%u de '%s' iniciada no tópico '%s' (%u bytes).\n",
+               msg->stream_id, msg->username, msg->topic, msg->stream_total);
+        deliver_to_subscribers(state, topic, msg);
+        pthread_mutex_unlock(&state->lock);
+        return;
+    }
+
+    deliver_to_subscribers(state, topic, msg);
+
+    printf("Mensagem enviada ao tópico '%s' por '%s'.\n", msg->topic, msg->username);
+    pthread_mutex_unlock(&state->lock);
+}
+
+
+
+void handle_init(ManagerState *state, const Message *msg) {
+    int result = add_feed(state, msg->username, msg->body, msg->flags);
+    if (result == 0) {
+        printf("Feed '%s' conectado.\n", msg->username);
+    } else if (result == 1) {
+        printf("Feed '%s' a aguardar abertura do pipe.\n", msg->username);
+    } else {
+        printf("Erro: Limite de feeds atingido ou falha na conexão.\n");
+    }
+}
+
+void handle_exit(ManagerState *state, const Message *msg) {
+    printf("Feed '%s' desconectado.\n", msg->username);
+    remove_feed(state, msg->username);
+}
+
+void handle_subscribe(ManagerState *state, const Message *msg) {
+    // O corpo do SUB, se existir, é o filtro da subscrição
+    subscribe_feed_to_topic(state, msg->username, msg->topic, msg->body);
+}
+
+void handle_unsubscribe(ManagerState *state, const Message *msg) {
+    unsubscribe_feed_from_topic(state, msg->username, msg->topic);
+}
+
+// Tabela de despacho das tramas recebidas dos feeds, indexada pelo opcode
+typedef void (*FeedHandler)(ManagerState *state, const Message *msg);
+static const FeedHandler feed_handlers[OP_COUNT] = {
+    [OP_INIT]  = handle_init,
+    [OP_EXIT]  = handle_exit,
+    [OP_MSG]   = process_message,
+    [OP_SUB]   = handle_subscribe,
+    [OP_UNSUB] = handle_unsubscribe,
+};
+
+void process_command(ManagerState *state, const Message *msg) {
+    FeedHandler handler = feed_handlers[protocol_decode_action(msg->action)];
+    if (handler) {
+        handler(state, msg);
+    }
+}
+
+
+// Lista os utilizadores conectados. O lock só é mantido para copiar os contadores; a
+// escrita no terminal faz-se depois, para não atrasar a publicação.
+void list_users(ManagerState *state) {
+    struct {
+        char username[50];
+        int pending[QOS_COUNT];
+        long long dropped;
+    } users[MAX_FEEDS];
+
+    pthread_mutex_lock(&state->lock);
+    int count = state->feed_count;
+    for (int i = 0; i < count; i++) {
+        memcpy(users[i].username, state->feeds[i].username, sizeof(users[i].username));
+        for (int qos = 0; qos < QOS_COUNT; qos++) {
+            users[i].pending[qos] = state->feeds[i].out[qos].count;
+        }
+        users[i].dropped = state->feeds[i].dropped;
+    }
+    pthread_mutex_unlock(&state->lock);
+
+    printf("Utilizadores conectados:\n");
+    for (int i = 0; i < count; i++) {
+        printf("- %s (por entregar: controlo %d, urgente %d, normal %d, bulk %d; descartadas %lld)\n",
+               users[i].username, users[i].pending[QOS_CONTROL], users[i].pending[QOS_URGENT],
+               users[i].pending[QOS_NORMAL], users[i].pending[QOS_BULK], users[i].dropped);
+    }
+}
+
+// Esquece as sessões guardadas de um utilizador. Chamar com state->lock adquirido.
+void drop_sessions(ManagerState *state, const char *username) {
+    for (int i = 0; i < state->topic_count; i++) {
+        Topic *topic = &state->topics[i];
+        for (int j = 0; j < topic->session_count; j++) {
+            if (strcmp(topic->sessions[j].username, username) == 0) {
+                topic->sessions[j--] = topic->sessions[--topic->session_count];
+                topic->version++;
+            }
+        }
+    }
+}
+
+// Remove um utilizador
+void remove_user(ManagerState *state, const char *username) {
+    pthread_mutex_lock(&state->lock);
+    for (int i = 0; i < state->feed_count; i++) {
+        if (strcmp(state->feeds[i].username, username) == 0) {
+            // Notificar o feed a ser removido
+            Message msg = {0};
+            protocol_set_action(&msg, OP_EXIT);
+            if (protocol_write_frame(state->feeds[i].pipe_fd, &msg) == -1) {
+                perror("Erro ao notificar feed");
+            }
+
+            // Remover o feed (descarta o que ainda tinha por entregar) e a sua sessão
+            detach_feed(state, i);
+            drop_sessions(state, username);
+
+            // Notificar outros feeds
+            Message notif = {0};
+            notif.priority = QOS_CONTROL;
+            message_format_body(&notif, "Utilizador '%s' foi removido.", username);
+            for (int j = 0; j < state->feed_count; j++) {
+                enqueue_for_feed(state, &state->feeds[j], &notif);
+            }
+
+            pthread_mutex_unlock(&state->lock);
+            printf("Utilizador '%s' removido.\n", username);
+            return;
+        }
+    }
+    pthread_mutex_unlock(&state->lock);
+    printf("Utilizador '%s' não encontrado.\n", username);
+}
+
+// Resumo de um tópico copiado sob o lock, para os comandos administrativos
+typedef struct {
+    char name[MAX_TOPIC_NAME];
+    int msg_count;
+    int locked;
+    int compress;
+    long long bytes_raw;
+    long long bytes_out;
+    long long codec_ns;
+    int filtered;
+    int pattern_count;
+    long long filtered_out;
+} TopicSummary;
+
+// Lista os tópicos existentes
+void list_topics(ManagerState *state) {
+    TopicSummary summaries[MAX_TOPICS];
+
+    pthread_mutex_lock(&state->lock);
+    int count = state->topic_count;
+    for (int i = 0; i < count; i++) {
+        Topic *topic = &state->topics[i];
+        TopicSummary *summary = &summaries[i];
+        memcpy(summary->name, topic->name, MAX_TOPIC_NAME);
+        summary->msg_count = topic->msg_count;
+        summary->locked = topic_is_locked(topic);
+        summary->compress = topic->compress;
+        summary->bytes_raw = topic->bytes_raw;
+        summary->bytes_out = topic->bytes_out;
+        summary->codec_ns = topic->codec_ns;
+        summary->filtered = topic->filtered;
+        summary->pattern_count = topic->matcher.pattern_count;
+        summary->filtered_out = topic->filtered_out;
+    }
+    pthread_mutex_unlock(&state->lock);
+
+    printf("Tópicos existentes:\n");
+    for (int i = 0; i < count; i++) {
+        TopicSummary *topic = &summaries[i];
+        printf("- %s (Mensagens persistentes: %d, Bloqueado: %s, Compressão: %s)\n", 
+               topic->name, topic->msg_count, 
+               topic->locked ? "Sim" : "Não",
+               topic->compress == COMPRESS_LZ ? "lz" : "Não");
+        if (topic->compress == COMPRESS_LZ && topic->bytes_raw > 0) {
+            printf("  Bytes entregues: %lld (sem compressão: %lld, %.1f%%), CPU de compressão: %lld us\n",
+                   topic->bytes_out, topic->bytes_raw, 100.0 * topic->bytes_out / topic->bytes_raw,
+                   topic->codec_ns / 1000);
+        } else if (topic->bytes_raw > 0) {
+            printf("  Bytes entregues: %lld (sem compressão)\n", topic->bytes_out);
+        }
+        if (topic->filtered) {
+            printf("  Filtros: %d padrões, %lld entregas evitadas\n", topic->pattern_count, topic->filtered_out);
+        }
+    }
+}
+
+// Mostra as mensagens de um tópico. As mensagens são copiadas sob o lock e
+// descomprimidas e escritas depois.
+void show_topic_messages(ManagerState *state, const char *topic_name) {
+    Message *copies[5];
+    int count = 0;
+
+    pthread_mutex_lock(&state->lock);
+    Topic *topic = find_topic(state, topic_name);
+    for (int j = 0; topic && j < topic->msg_count; j++) {
+        if ((copies[count] = message_clone(topic->messages[j])) != NULL) {
+            count++;
+        }
+    }
+    pthread_mutex_unlock(&state->lock);
+
+    if (!topic) {
+        printf("Tópico '%s' não encontrado.\n", topic_name);
+        return;
+    }
+
+    printf("Mensagens no tópico '%s':\n", topic_name);
+    Message shown;
+    for (int j = 0; j < count; j++) {
+        message_copy(&shown, copies[j]);
+        free(copies[j]);
+        if (message_decompress(&shown) != 0) {
+            continue;
+        }
+        printf("- %s: %s\n", shown.username, shown.body);
+    }
+}
+
+// Ativa ou desativa a compressão das mensagens de um tópico
+void set_topic_compression(ManagerState *state, const char *topic_name, int mode) {
+    pthread_mutex_lock(&state->lock);
+    Topic *topic = find_topic(state, topic_name);
+    if (topic) {
+        topic->compress = mode;
+        topic->version++;
+    }
+    pthread_mutex_unlock(&state->lock);
+
+    if (topic) {
+        printf("Compressão do tópico '%s' %s.\n", topic_name, mode == COMPRESS_LZ ? "ativada" : "desativada");
+    } else {
+        printf("Tópico '%s' não encontrado.\n", topic_name);
+    }
+}
+
+// Bloqueia ou desbloqueia um tópico sem o lock global: as flags encontram-se pelo
+// diretório publicado e a mudança é uma escrita atómica, vista de imediato pelo despacho.
+void set_topic_lock(ManagerState *state, const char *topic_name, int lock) {
+    rcu_read_lock(state, RCU_ADMIN);
+    TopicFlags *flags = lookup_topic_flags(state, topic_name);
+    if (flags) {
+        __atomic_store_n(&flags->locked, lock, __ATOMIC_RELEASE);
+    }
+    rcu_read_unlock(state, RCU_ADMIN);
+
+    if (flags) {
+        printf("Tópico '%s' %s.\n", topic_name, lock ? "bloqueado" : "desbloqueado");
+    } else {
+        printf("Tópico '%s' não encontrado.\n", topic_name);
+    }
+}
+
+// Encerra a plataforma
+void close_platform(ManagerState *state) {
+    pthread_mutex_lock(&state->lock);
+    state->running = 0;
+
+    // Notificar todos os feeds. As subscrições ficam guardadas como sessões para quando voltarem.
+    Message msg = {0};
+    protocol_set_action(&msg, OP_EXIT);
+    while (state->feed_count > 0) {
+        if (protocol_write_frame(state->feeds[0].pipe_fd, &msg) == -1) {
+            perror("Erro ao notificar feed");
+        }
+        detach_feed(state, 0);
+    }
+    pthread_mutex_unlock(&state->lock);
+
+    printf("Plataforma encerrada.\n");
+}
+
+void admin_users(ManagerState *state, const char *args) {
+    list_users(state);
+}
+
+void admin_topics(ManagerState *state, const char *args) {
+    list_topics(state);
+}
+
+void admin_lock(ManagerState *state, const char *args) {
+    set_topic_lock(state, args, 1);
+}
+
+void admin_unlock(ManagerState *state, const char *args) {
+    set_topic_lock(state, args, 0);
+}
+
+void admin_compress(ManagerState *state, const char *args) {
+    char topic_name[MAX_TOPIC_NAME];
+    char mode[8];
+
+    if (sscanf(args, "%19s %7s", topic_name, mode) != 2 || (strcmp(mode, "on") != 0 && strcmp(mode, "off") != 0)) {
+        printf("Erro: Uso: compress <topico> <on|off>\n");
+        return;
+    }
+
+    set_topic_compression(state, topic_name, strcmp(mode, "on") == 0 ? COMPRESS_LZ : COMPRESS_NONE);
+}
+
+// Define ou remove um limite de envio
+void set_rate_limit(ManagerState *state, int kind, const char *name, double rate, double burst) {
+    pthread_mutex_lock(&state->lock);
+
+    int kept = 0;
+    for (int i = 0; i < state->limit_count; i++) {
+        RateLimit *limit = &state->limits[i];
+        if (limit->kind != kind || strcmp(limit->name, name) != 0) {
+            state->limits[kept++] = *limit;
+        }
+    }
+    state->limit_count = kept;
+
+    // Os baldes herdados de "*" são recriados com os novos valores no próximo uso
+    if (strcmp(name, "*") == 0) {
+        kept = 0;
+        for (int i = 0; i < state->inherited_count; i++) {
+            if (state->inherited_limits[i].kind != kind) {
+                state->inherited_limits[kept++] = state->inherited_limits[i];
+            }
+        }
+        state->inherited_count = kept;
+    } else {
+        drop_inherited_limit(state, kind, name);
+    }
+
+    int full = rate > 0 && state->limit_count >= MAX_LIMITS;
+    if (rate > 0 && !full) {
+        RateLimit *limit = &state->limits[state->limit_count++];
+        memset(limit, 0, sizeof(*limit));
+        limit->kind = kind;
+        strncpy(limit->name, name, sizeof(limit->name) - 1);
+        limit->bucket.rate = rate;
+        limit->bucket.burst = burst < 1 ? 1 : burst;
+        limit->bucket.tokens = limit->bucket.burst;
+        limit->bucket.last_ns = monotonic_ns();
+    }
+    pthread_mutex_unlock(&state->lock);
+
+    const char *what = kind == LIMIT_USER ? "utilizador" : "tópico";
+    if (rate <= 0) {
+        printf("Limite do %s '%s' removido.\n", what, name);
+    } else if (full) {
+        printf("Erro: Limite de entradas de limites atingido.\n");
+    } else {
+        printf("Limite do %s '%s': %.1f mensagens/s, rajada %.0f.\n", what, name, rate, burst < 1 ? 1 : burst);
+    }
+}
+
+void admin_limit(ManagerState *state, const char *args) {
+    char kind[8], name[50], rate_text[16];
+    double burst = 0;
+
+    int fields = sscanf(args, "%7s %49s %15s %lf", kind, name, rate_text, &burst);
+    int kind_id = strcmp(kind, "user") == 0 ? LIMIT_USER : strcmp(kind, "topic") == 0 ? LIMIT_TOPIC : -1;
+    int off = fields >= 3 && strcmp(rate_text, "off") == 0;
+
+    if (kind_id < 0 || (!off && fields != 4)) {
+        printf("Erro: Uso: limit <user|topic> <nome|*> <taxa/s> <rajada> ou limit <user|topic> <nome|*> off\n");
+        return;
+    }
+
+    set_rate_limit(state, kind_id, name, off ? 0 : atof(rate_text), burst);
+}
+
+// Lista os limites definidos e o estado da admissão. Copia os contadores sob os locks e
+// escreve depois, para a consola não atrasar a leitura do pipe nem o despacho.
+void admin_limits(ManagerState *state, const char *args) {
+    RateLimit limits[MAX_LIMITS + MAX_INHERITED_LIMITS];
+    int queued[QOS_COUNT];
+
+    pthread_mutex_lock(&state->lock);
+    int count = state->limit_count;
+    memcpy(limits, state->limits, count * sizeof(RateLimit));
+    memcpy(limits + count, state->inherited_limits, state->inherited_count * sizeof(RateLimit));
+    count += state->inherited_count;
+    pthread_mutex_lock(&state->queue_lock);
+    for (int qos = 0; qos < QOS_COUNT; qos++) {
+        queued[qos] = state->inbound[qos].count;
+    }
+    long long shed = state->shed_count;
+    pthread_mutex_unlock(&state->queue_lock);
+    pthread_mutex_unlock(&state->lock);
+
+    printf("Limites de envio:\n");
+    for (int i = 0; i < count; i++) {
+        RateLimit *limit = &limits[i];
+        printf("- %s %s: %.1f/s, rajada %.0f, rejeitadas %lld%s\n",
+               limit->kind == LIMIT_USER ? "user" : "topic", limit->name,
+               limit->bucket.rate, limit->bucket.burst, limit->rejected,
+               limit->inherited ? " (herdado de *)" : "");
+    }
+    printf("Filas de entrada (de %d): controlo %d, urgente %d, normal %d, bulk %d; %lld mensagens descartadas por sobrecarga\n",
+           QUEUE_CAPACITY, queued[QOS_CONTROL], queued[QOS_URGENT], queued[QOS_NORMAL], queued[QOS_BULK], shed);
+}
+
+// Distribuição da latência de distribuição de um tópico (só mensagens enviadas com medição)
+void admin_latency(ManagerState *state, const char *args) {
+    char summary[256] = "";
+    pthread_mutex_lock(&state->lock);
+    Topic *topic = find_topic(state, args);
+    int found = topic != NULL;
+    if (topic && topic->fanout_hist) {
+        hist_format(topic->fanout_hist, summary, sizeof(summary));
+    }
+    pthread_mutex_unlock(&state->lock);
+
+    if (!found) {
+        printf("Tópico '%s' não encontrado.\n", args);
+    } else if (summary[0] == '\0') {
+        printf("Tópico '%s' sem mensagens medidas (os feeds têm de usar --trace).\n", args);
+    } else {
+        printf("Latência de distribuição no tópico '%s': %s\n", args, summary);
+    }
+}
+
+// Tempo de CPU, trocas de contexto e colocação de cada thread do manager
+void admin_threads(ManagerState *state, const char *args) {
+    ThreadInfo threads[MAX_THREADS];
+    pthread_mutex_lock(&state->lock);
+    int count = state->thread_count;
+    memcpy(threads, state->threads, count * sizeof(ThreadInfo));
+    pthread_mutex_unlock(&state->lock);
+
+    printf("Threads do manager:\n");
+    for (int i = 0; i < count; i++) {
+        ThreadStats stats;
+        if (read_thread_stats(threads[i].tid, &stats) != 0) {
+            printf("- %s (tid %d): terminada\n", threads[i].name, threads[i].tid);
+            continue;
+        }
+
+        cpu_set_t cpus;
+        char affinity[128] = "?";
+        if (sched_getaffinity(threads[i].tid, sizeof(cpus), &cpus) == 0) {
+            format_cpu_list(&cpus, affinity, sizeof(affinity));
+        }
+        int node = cpu_node(stats.last_cpu);
+        char node_text[16] = "?";
+        if (node >= 0) {
+            snprintf(node_text, sizeof(node_text), "%d", node);
+        }
+
+        printf("- %s (tid %d): CPU %.0f ms (utilizador %.0f, sistema %.0f), trocas de contexto %ld voluntárias "
+               "e %ld forçadas, último CPU %d (nó %s), afinidade %s\n",
+               threads[i].name, threads[i].tid, stats.user_ms + stats.system_ms, stats.user_ms, stats.system_ms,
+               stats.voluntary, stats.involuntary, stats.last_cpu, node_text, affinity);
+    }
+}
+
+void admin_close(ManagerState *state, const char *args) {
+    close_platform(state);
+}
+
+// Tabela de despacho dos comandos do administrador, indexada pelo opcode
+typedef void (*AdminHandler)(ManagerState *state, const char *args);
+static const AdminHandler admin_handlers[OP_COUNT] = {
+    [OP_USERS]    = admin_users,
+    [OP_REMOVE]   = remove_user,
+    [OP_TOPICS]   = admin_topics,
+    [OP_SHOW]     = show_topic_messages,
+    [OP_LOCK]     = admin_lock,
+    [OP_UNLOCK]   = admin_unlock,
+    [OP_COMPRESS] = admin_compress,
+    [OP_LIMIT]    = admin_limit,
+    [OP_LIMITS]   = admin_limits,
+    [OP_LATENCY]  = admin_latency,
+    [OP_THREADS]  = admin_threads,
+    [OP_CLOSE]    = admin_close,
+};
+
+// Thread para comandos do administrador
+void *admin_commands(void *arg) {
+    ManagerState *state = (ManagerState *)arg;
+    thread_start(state, "admin");
+    char command[100];
+    ParsedCommand cmd;
+
+    while (state->running) {
+        printf("Admin> ");
+        if (fgets(command, sizeof(command), stdin) == NULL) break;
+
+        command[strcspn(command, "\n")] = '\0'; // Remover newline
+
+        if (protocol_parse_command(command, DOM_ADMIN, &cmd) != 0) {
+            printf("Comando desconhecido: %s. Tente um dos seguintes: %s\n", command, protocol_command_list(DOM_ADMIN));
+            continue;
+        }
+
+        if (cmd.usage && cmd.args[0] == '\0') {
+            printf("Erro: O comando '%s' requer %s. Uso: %s %s\n", cmd.verb, cmd.usage, cmd.verb, cmd.usage);
+            continue;
+        }
+
+        admin_handlers[cmd.opcode](state, cmd.args);
+        if (cmd.opcode == OP_CLOSE) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+// Classe de serviço de uma trama recebida. Os comandos de controlo são classificados
+// pelo manager; um feed não pode reclamar a classe de controlo para as suas mensagens.
+int classify_frame(const Message *msg) {
+    switch (protocol_decode_action(msg->action)) {
+    case OP_INIT:
+    case OP_EXIT:
+    case OP_SUB:
+    case OP_UNSUB:
+        return QOS_CONTROL;
+    default:
+        return msg->priority < QOS_CONTROL ? msg->priority : QOS_NORMAL;
+    }
+}
+
+// Coloca uma trama recebida na fila da sua classe. Com a fila cheia, as mensagens são
+// descartadas (com aviso ao emissor) e os comandos de controlo esperam por espaço. Os blocos
+// de uma mensagem longa já rejeitada nem chegam à fila. Devolve -1 se a trama se perdeu.
+int enqueue_inbound(ManagerState *state, const Message *msg) {
+    Message *frame = message_clone(msg);
+    if (!frame) {
+        perror("Erro ao guardar trama recebida");
+        return -1;
+    }
+    frame->priority = classify_frame(msg);
+
+    pthread_mutex_lock(&state->queue_lock);
+    ShedStream *shed = find_shed_stream(state, frame);
+    if (shed && frame->stream_offset == 0) {
+        // Nova mensagem longa com o identificador de uma antiga (o feed voltou a ligar-se)
+        *shed = state->shed_streams[--state->shed_stream_count];
+    } else if (shed) {
+        state->shed_count++;
+        pthread_mutex_unlock(&state->queue_lock);
+        free(frame);
+        return -1;
+    }
+
+    FrameQueue *queue = &state->inbound[frame->priority];
+    while (frame->priority == QOS_CONTROL && queue->count >= QUEUE_CAPACITY && state->running) {
+        pthread_cond_wait(&state->queue_ready, &state->queue_lock);
+    }
+
+    int result = queue_push(queue, frame);
+    if (result != 0) {
+        shed_frame(state, frame);
+    } else {
+        __atomic_add_fetch(&state->inbound_pending, 1, __ATOMIC_RELEASE);
+        pthread_cond_broadcast(&state->queue_ready);
+    }
+    pthread_mutex_unlock(&state->queue_lock);
+
+    if (result != 0) {
+        pthread_mutex_lock(&state->lock);
+        notify_overload(state, frame);
+        ActiveStream *stream = (frame->flags & FRAME_CHUNK) ? find_stream(state, frame->username, frame->stream_id) : NULL;
+        if (stream) {
+            abort_stream(state, stream, frame);
+        }
+        pthread_mutex_unlock(&state->lock);
+        free(frame);
+    }
+    return result;
+}
+
+// Abre a gravação das tramas recebidas pedida em MANAGER_RECORD
+void open_record(ManagerState *state, const char *path) {
+    state->record_file = fopen(path, "wb");
+    unsigned int magic = RECORD_MAGIC;
+    if (!state->record_file || fwrite(&magic, sizeof(magic), 1, state->record_file) != 1) {
+        perror("Erro ao abrir ficheiro de gravação");
+        if (state->record_file) {
+            fclose(state->record_file);
+            state->record_file = NULL;
+        }
+        return;
+    }
+    state->record_start_ns = monotonic_ns();
+    printf("A gravar as tramas recebidas em '%s'.\n", path);
+}
+
+// Acrescenta à gravação uma trama tal como foi lida do pipe. Só a thread de leitura escreve.
+void record_frame(ManagerState *state, const Message *msg) {
+    RecordEntry entry = {monotonic_ns() - state->record_start_ns, FRAME_HEADER_SIZE + msg->body_len};
+    if (fwrite(&entry, sizeof(entry), 1, state->record_file) != 1 ||
+        fwrite(msg, entry.len, 1, state->record_file) != 1) {
+        perror("Erro ao gravar trama recebida");
+        fclose(state->record_file);
+        state->record_file = NULL;
+        return;
+    }
+
+    if (++state->record_pending >= RECORD_FLUSH_FRAMES) {
+        fflush(state->record_file);
+        state->record_pending = 0;
+    }
+}
+
+// Thread que lê as tramas do pipe do manager e as separa por classe de serviço
+void *read_commands_thread(void *arg) {
+    struct {
+        int fd;
+        ManagerState *state;
+    } *params = arg;
+
+    int manager_fd = params->fd;
+    ManagerState *state = params->state;
+    thread_start(state, "reader");
+
+    Message msg;
+    struct pollfd pfd = {manager_fd, POLLIN, 0};
+
+    while (state->running) {
+        // Espera limitada para reparar no fim da plataforma
+        if (poll(&pfd, 1, DISPATCH_POLL_MS) <= 0) {
+            // Pipe parado: passar para o disco o que falta da gravação
+            if (state->record_file && state->record_pending > 0) {
+                fflush(state->record_file);
+                state->record_pending = 0;
+            }
+            continue;
+        }
+
+        int bytes_read = protocol_read_frame(manager_fd, &msg);
+        if (bytes_read > 0) {
+            if (state->record_file) {
+                record_frame(state, &msg);
+            }
+            enqueue_inbound(state, &msg);
+        } else if (bytes_read == 0) {
+            // Fim de comunicação
+            break;
+        } else {
+            perror("Erro ao ler do pipe do manager");
+        }
+    }
+
+    // Acordar a thread de despacho para que também termine
+    pthread_mutex_lock(&state->queue_lock);
+    state->running = 0;
+    pthread_cond_broadcast(&state->queue_ready);
+    pthread_mutex_unlock(&state->queue_lock);
+
+    printf("Thread de leitura de comandos encerrada.\n");
+    return NULL;
+}
+
+// Thread que processa as tramas recebidas pela ordem do escalonamento ponderado
+void *process_commands_thread(void *arg) {
+    ManagerState *state = (ManagerState *)arg;
+    thread_start(state, "dispatch");
+    long long spin_ns = state->spin_max_ns;
+
+    while (1) {
+        // Fila vazia: espera ativa antes de dormir na condição, para não pagar o custo de
+        // acordar quando as tramas chegam em rajada. O tempo de espera duplica quando chega
+        // uma trama e cai para metade quando não chega nenhuma, até SPIN_MIN_NS.
+        if (spin_ns > 0 && __atomic_load_n(&state->inbound_pending, __ATOMIC_ACQUIRE) == 0) {
+            long long deadline = monotonic_ns() + spin_ns;
+            while (__atomic_load_n(&state->inbound_pending, __ATOMIC_ACQUIRE) == 0 && state->running &&
+                   monotonic_ns() < deadline) {
+                CPU_RELAX();
+            }
+            if (__atomic_load_n(&state->inbound_pending, __ATOMIC_ACQUIRE) > 0) {
+                spin_ns = spin_ns * 2 < state->spin_max_ns ? spin_ns * 2 : state->spin_max_ns;
+            } else {
+                spin_ns = spin_ns / 2 > SPIN_MIN_NS ? spin_ns / 2 : SPIN_MIN_NS;
+            }
+        }
+
+        pthread_mutex_lock(&state->queue_lock);
+        int qos;
+        while ((qos = qos_pick(state->inbound, state->inbound_credits)) < 0 && state->running) {
+            pthread_cond_wait(&state->queue_ready, &state->queue_lock);
+        }
+        if (qos < 0) {
+            pthread_mutex_unlock(&state->queue_lock);
+            break;
+        }
+
+        Message *frame = queue_pop(&state->inbound[qos]);
+        __atomic_sub_fetch(&state->inbound_pending, 1, __ATOMIC_RELAXED);
+        pthread_cond_broadcast(&state->queue_ready); // Há espaço na fila
+        pthread_mutex_unlock(&state->queue_lock);
+
+        if (frame->flags & FRAME_TRACED) {
+            frame->t_dequeue = monotonic_ns();
+        }
+
+        // Processar comando recebido
+        process_command(state, frame);
+        if (state->replay_hist) {
+            hist_record(state->replay_hist, monotonic_ns() - frame->t_publish);
+        }
+        free(frame);
+    }
+
+    printf("Thread de processamento de comandos encerrada.\n");
+    return NULL;
+}
+
+// Regista no tópico o tempo desde a saída da fila de entrada até à escrita no pipe do
+// subscritor. O histograma só é criado quando chega a primeira trama com FRAME_TRACED.
+void record_fanout_latency(ManagerState *state, const Message *frame) {
+    Topic *topic = find_topic(state, frame->topic);
+    if (!topic) {
+        return;
+    }
+    if (!topic->fanout_hist) {
+        topic->fanout_hist = calloc(1, sizeof(Histogram));
+        if (!topic->fanout_hist) {
+            return;
+        }
+    }
+    hist_record(topic->fanout_hist, monotonic_ns() - frame->t_dequeue);
+}
+
+// Escreve no pipe do feed as tramas por entregar, pela ordem do escalonamento, até o
+// pipe encher. Devolve 1 se ficaram tramas à espera. Chamar com state->lock adquirido.
+int flush_feed(ManagerState *state, Feed *feed) {
+    int qos;
+    while ((qos = qos_pick(feed->out, feed->credits)) >= 0) {
+        Message *frame = queue_peek(&feed->out[qos]);
+        if (protocol_write_frame(feed->pipe_fd, frame) == -1) {
+            if (errno == EAGAIN) {
+                feed->credits[qos]++; // A vez não foi usada
+                return 1;
+            }
+            // Leitor desapareceu (EPIPE): a thread de ligações remove o feed
+            feed->dropped++;
+        } else if (frame->flags & FRAME_TRACED) {
+            record_fanout_latency(state, frame);
+        }
+        free(queue_pop(&feed->out[qos]));
+    }
+    return 0;
+}
+
+// Thread que entrega as tramas enfileiradas aos feeds sem nunca bloquear num feed lento
+void *deliver_feeds_thread(void *arg) {
+    ManagerState *state = (ManagerState *)arg;
+    thread_start(state, "delivery");
+    struct pollfd pfds[MAX_FEEDS + 1];
+    char drain[64];
+
+    while (state->running) {
+        int count = 1;
+        pfds[0] = (struct pollfd){state->wake_fds[0], POLLIN, 0};
+
+        pthread_mutex_lock(&state->lock);
+        for (int i = 0; i < state->feed_count; i++) {
+            if (flush_feed(state, &state->feeds[i])) {
+                pfds[count++] = (struct pollfd){state->feeds[i].pipe_fd, POLLOUT, 0};
+            }
+        }
+        pthread_mutex_unlock(&state->lock);
+
+        // Esperar por espaço num pipe cheio ou por novas tramas
+        poll(pfds, count, DISPATCH_POLL_MS);
+        while (read(state->wake_fds[0], drain, sizeof(drain)) > 0) {
+        }
+    }
+
+    return NULL;
+}
+
+
+// Função para a Thread de Monitorização
+void *monitor_persistent_messages(void *arg) {
+    ManagerState *state = (ManagerState *)arg;
+    thread_start(state, "monitor");
+
+    while (state->running) {
+        pthread_mutex_lock(&state->lock);
+
+        // Incrementar "ticks"
+        state->ticks++;
+
+        for (int i = 0; i < state->topic_count; i++) {
+            Topic *topic = &state->topics[i];
+
+            // Verificar mensagens persistentes no tópico
+            int new_count = 0;
+            for (int j = 0; j < topic->msg_count; j++) {
+                Message *msg = topic->messages[j];
+                if (state->ticks - msg->created_time < msg->duration) {
+                    topic->messages[new_count++] = msg;
+                } else {
+                    printf("Mensagem de '%s' no tópico '%s' expirou e foi removida.\n",
+                           msg->username, msg->topic);
+                    free(msg);
+                }
+            }
+            if (new_count != topic->msg_count) {
+                topic->version++;
+            }
+            topic->msg_count = new_count;
+
+            // Esquecer as sessões de feeds que não voltaram a ligar-se
+            int expired = 0;
+            for (int j = 0; j < topic->session_count; j++) {
+                if (state->ticks - topic->sessions[j].saved_tick >= SESSION_TTL_TICKS) {
+                    printf("Sessão de '%s' no tópico '%s' expirou e foi removida.\n",
+                           topic->sessions[j].username, topic->name);
+                    topic->sessions[j--] = topic->sessions[--topic->session_count];
+                    topic->version++;
+                    expired = 1;
+                }
+            }
+
+            // Remover o tópico que só existia por causa dessas sessões
+            if (expired && topic->sub_count == 0 && topic->session_count == 0) {
+                printf("Tópico '%s' removido (sem subscritores).\n", topic->name);
+                record_topic_removal(state, topic->name);
+                destroy_topic(state, i--);
+            }
+        }
+
+        pthread_mutex_unlock(&state->lock);
+
+        sleep(1); // Simular "tick" a cada 1 segundo
+    }
+
+    return NULL;
+}
+
+// Thread que conclui ligações pendentes e limpa feeds meio-abertos
+void *monitor_connections(void *arg) {
+    ManagerState *state = (ManagerState *)arg;
+    thread_start(state, "connections");
+
+    while (state->running) {
+        pthread_mutex_lock(&state->lock);
+        long long now = monotonic_ms();
+
+        // Tentar de novo as ligações pendentes
+        int kept = 0;
+        for (int i = 0; i < state->pending_count; i++) {
+            PendingFeed *pending = &state->pending[i];
+            int fd = open_feed_pipe(pending->pipe_name);
+
+            if (fd != -1) {
+                if (attach_feed(state, pending->username, pending->pipe_name, pending->flags, fd) == 0) {
+                    printf("Feed '%s' conectado.\n", pending->username);
+                }
+            } else if (errno == ENXIO && now < pending->deadline_ms) {
+                state->pending[kept++] = *pending;
+            } else {
+                printf("Ligação do feed '%s' expirou sem handshake.\n", pending->username);
+            }
+        }
+        state->pending_count = kept;
+
+        // Largar as recusas cujo feed já teve tempo de ler a resposta
+        kept = 0;
+        for (int i = 0; i < state->rejected_count; i++) {
+            if (now < state->rejected[i].deadline_ms) {
+                state->rejected[kept++] = state->rejected[i];
+            } else {
+                close(state->rejected[i].fd);
+            }
+        }
+        state->rejected_count = kept;
+
+        // Mensagens longas sem blocos há demasiado tempo (emissor terminou a meio)
+        for (int i = 0; i < state->stream_count; i++) {
+            if (now - state->streams[i].last_ms > STREAM_IDLE_MS) {
+                printf("Mensagem longa #%u de '%s' abandonada.\n", state->streams[i].stream_id, state->streams[i].username);
+                end_stream(state, &state->streams[i]);
+                i--;
+            }
+        }
+
+        // Feeds cujo leitor desapareceu ficam com POLLERR no pipe
+        for (int i = 0; i < state->feed_count; i++) {
+            struct pollfd pfd = {state->feeds[i].pipe_fd, 0, 0};
+            if (poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))) {
+                printf("Feed '%s' deixou de responder e foi removido.\n", state->feeds[i].username);
+                detach_feed(state, i);
+                i--;
+            }
+        }
+
+        pthread_mutex_unlock(&state->lock);
+
+        usleep(REAPER_INTERVAL_MS * 1000);
+    }
+
+    return NULL;
+}
+
+static const char base64_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Codifica len bytes em base64 (out com pelo menos BASE64_LEN(len) + 1 bytes)
+void base64_encode(const unsigned char *in, int len, char *out) {
+    int o = 0;
+    for (int i = 0; i < len; i += 3) {
+        unsigned int v = in[i] << 16;
+        if (i + 1 < len) v |= in[i + 1] << 8;
+        if (i + 2 < len) v |= in[i + 2];
+
+        out[o++] = base64_alphabet[(v >> 18) & 63];
+        out[o++] = base64_alphabet[(v >> 12) & 63];
+        out[o++] = i + 1 < len ? base64_alphabet[(v >> 6) & 63] : '=';
+        out[o++] = i + 2 < len ? base64_alphabet[v & 63] : '=';
+    }
+    out[o] = '\0';
+}
+
+// Devolve o número de bytes descodificados, ou -1 se o texto for inválido
+int base64_decode(const char *in, unsigned char *out, int out_cap) {
+    int o = 0;
+    unsigned int v = 0;
+    int bits = 0;
+
+    for (; *in && *in != '='; in++) {
+        const char *p = strchr(base64_alphabet, *in);
+        if (!p || *in == '\0') {
+            return -1;
+        }
+        v = (v << 6) | (unsigned int)(p - base64_alphabet);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            if (o >= out_cap) {
+                return -1;
+            }
+            out[o++] = (unsigned char)(v >> bits);
+        }
+    }
+    return o;
+}
+
+// Copia os tópicos (todos ou só os alterados desde o último snapshot) e as mensagens
+// retidas. Chamar com state->lock adquirido; a escrita faz-se depois, fora do lock.
+int copy_topics(ManagerState *state, TopicCopy *copies, int dirty_only) {
+    int count = 0;
+    for (int i = 0; i < state->topic_count; i++) {
+        Topic *topic = &state->topics[i];
+        int locked = topic_is_locked(topic);
+        if (dirty_only && topic->version == topic->snap_version && locked == topic->snap_locked) {
+            continue;
+        }
+
+        TopicCopy *copy = &copies[count++];
+        memset(&copy->record, 0, sizeof(copy->record));
+        copy->record.kind = SNAP_TOPIC;
+        copy->record.is_locked = locked;
+        copy->record.compress = topic->compress;
+        strncpy(copy->record.name, topic->name, MAX_TOPIC_NAME);
+        copy->record.last_seq = topic->last_seq;
+
+        // Sessões dos subscritores ligados e dos feeds desligados
+        for (int j = 0; j < topic->sub_count && copy->record.sub_count < MAX_FEEDS; j++) {
+            Feed *feed = topic->subscribers[j];
+            copy->record.subscriber_seq[copy->record.sub_count] = delivered_seq(feed, topic->name, topic->sub_seq[j]);
+            memcpy(copy->record.subscriber_filter[copy->record.sub_count], topic->sub_filter[j], MAX_FILTER_LEN);
+            strncpy(copy->record.subscribers[copy->record.sub_count++], feed->username, 50);
+        }
+        for (int j = 0; j < topic->session_count && copy->record.sub_count < MAX_FEEDS; j++) {
+            copy->record.subscriber_seq[copy->record.sub_count] = topic->sessions[j].last_seq;
+            memcpy(copy->record.subscriber_filter[copy->record.sub_count], topic->sessions[j].filter, MAX_FILTER_LEN);
+            strncpy(copy->record.subscribers[copy->record.sub_count++], topic->sessions[j].username, 50);
+        }
+
+        for (int j = 0; j < topic->msg_count; j++) {
+            Message *msg = message_clone(topic->messages[j]);
+            if (msg) {
+                copy->messages[copy->record.msg_count++] = msg;
+            }
+        }
+    }
+    return count;
+}
+
+void free_topic_copies(TopicCopy *copies, int count) {
+    for (int i = 0; i < count; i++) {
+        for (int j = 0; j < copies[i].record.msg_count; j++) {
+            free(copies[i].messages[j]);
+        }
+    }
+}
+
+// Acrescenta um registo ao lote em construção. Devolve -1 se não houver memória.
+int snapshot_append(char **buffer, size_t *len, size_t *cap, const void *data, size_t size) {
+    if (*len + size > *cap) {
+        size_t new_cap = (*cap ? *cap * 2 : 4096) + size;
+        char *grown = realloc(*buffer, new_cap);
+        if (!grown) {
+            return -1;
+        }
+        *buffer = grown;
+        *cap = new_cap;
+    }
+    memcpy(*buffer + *len, data, size);
+    *len += size;
+    return 0;
+}
+
+// Reescreve o diário só com o lote indicado (ficheiro temporário + rename)
+int snapshot_compact(ManagerState *state, const char *buffer, size_t len) {
+    char tmp_path[sizeof(state->snapshot_path) + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", state->snapshot_path);
+
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd == -1) {
+        perror("Erro ao criar snapshot");
+        return -1;
+    }
+    if (write(fd, buffer, len) != (ssize_t)len || fdatasync(fd) == -1 || rename(tmp_path, state->snapshot_path) == -1) {
+        perror("Erro ao gravar snapshot");
+        close(fd);
+        unlink(tmp_path);
+        return -1;
+    }
+
+    // As escritas incrementais seguintes continuam no ficheiro novo
+    if (state->snapshot_fd != -1) {
+        close(state->snapshot_fd);
+    }
+    lseek(fd, 0, SEEK_END);
+    state->snapshot_fd = fd;
+    return 0;
+}
+
+// Grava no diário os tópicos alterados e removidos desde o último snapshot. O lock só é
+// mantido enquanto se copiam os tópicos alterados, por isso o custo acompanha o ritmo de
+// alterações e a publicação não fica parada durante a escrita.
+void write_snapshot(ManagerState *state) {
+    TopicCopy copies[MAX_TOPICS];
+    char removed[MAX_TOPICS][MAX_TOPIC_NAME];
+
+    if (state->snapshot_path[0] == '\0') {
+        return;
+    }
+
+    pthread_mutex_lock(&state->lock);
+    int full = state->snapshot_full;
+    int ticks = state->ticks;
+    int count = copy_topics(state, copies, !full);
+    int removed_count = full ? 0 : state->removed_count;
+    memcpy(removed, state->removed_topics, sizeof(removed[0]) * removed_count);
+
+    // Com mensagens retidas, o lote serve também de marca temporal para a sua duração
+    int retained = 0;
+    for (int i = 0; i < state->topic_count; i++) {
+        state->topics[i].snap_version = state->topics[i].version;
+        retained |= state->topics[i].msg_count > 0;
+    }
+
+    // O bloqueio muda sem o lock: guardar o valor que foi copiado, não o atual
+    for (int i = 0; i < count; i++) {
+        Topic *topic = find_topic(state, copies[i].record.name);
+        if (topic) {
+            topic->snap_locked = copies[i].record.is_locked;
+        }
+    }
+    state->removed_count = 0;
+    state->snapshot_full = 0;
+    pthread_mutex_unlock(&state->lock);
+
+    if (!full && count == 0 && removed_count == 0 && !retained) {
+        return;
+    }
+
+    // Montar o lote em memória e gravá-lo com uma única escrita
+    char *buffer = NULL;
+    size_t len = 0, cap = 0;
+    SnapBatch batch = {SNAP_MAGIC, ticks, count + removed_count};
+    int failed = snapshot_append(&buffer, &len, &cap, &batch, sizeof(batch));
+
+    for (int i = 0; i < removed_count && !failed; i++) {
+        SnapRecord tombstone = {0};
+        tombstone.kind = SNAP_TOMBSTONE;
+        strncpy(tombstone.name, removed[i], MAX_TOPIC_NAME);
+        failed = snapshot_append(&buffer, &len, &cap, &tombstone, sizeof(tombstone));
+    }
+    for (int i = 0; i < count && !failed; i++) {
+        failed = snapshot_append(&buffer, &len, &cap, &copies[i].record, sizeof(copies[i].record));
+        for (int j = 0; j < copies[i].record.msg_count && !failed; j++) {
+            failed = snapshot_append(&buffer, &len, &cap, copies[i].messages[j],
+                                     FRAME_HEADER_SIZE + copies[i].messages[j]->body_len);
+        }
+    }
+    free_topic_copies(copies, count);
+
+    struct stat st;
+    if (!failed) {
+        if (full || state->snapshot_fd == -1) {
+            failed = snapshot_compact(state, buffer, len);
+        } else if (write(state->snapshot_fd, buffer, len) != (ssize_t)len || fdatasync(state->snapshot_fd) == -1) {
+            perror("Erro ao gravar snapshot");
+            failed = 1;
+        } else if (fstat(state->snapshot_fd, &st) == 0 && st.st_size > SNAPSHOT_COMPACT_BYTES) {
+            failed = 1; // Diário grande: o próximo snapshot compacta-o
+        }
+    }
+    free(buffer);
+
+    // Alterações que não chegaram ao disco: o próximo snapshot grava o estado completo
+    if (failed) {
+        pthread_mutex_lock(&state->lock);
+        state->snapshot_full = 1;
+        pthread_mutex_unlock(&state->lock);
+    }
+}
+
+// Thread que grava snapshots incrementais periodicamente
+void *snapshot_thread(void *arg) {
+    ManagerState *state = (ManagerState *)arg;
+    thread_start(state, "snapshot");
+
+    while (state->running) {
+        usleep(SNAPSHOT_INTERVAL_MS * 1000);
+        write_snapshot(state);
+    }
+
+    return NULL;
+}
+
+// Aplica o diário de snapshots sobre o estado carregado do ficheiro de texto.
+// Um lote incompleto no fim (manager interrompido a meio da escrita) é ignorado.
+void load_snapshot(ManagerState *state) {
+    int fd = open(state->snapshot_path, O_RDONLY);
+    if (fd == -1) {
+        return;
+    }
+
+    struct stat st;
+    char *data = NULL;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        data = malloc(st.st_size);
+    }
+    if (!data || read(fd, data, st.st_size) != st.st_size) {
+        free(data);
+        close(fd);
+        return;
+    }
+    close(fd);
+
+    // Último estado conhecido de cada tópico (os registos mais recentes substituem os anteriores)
+    TopicCopy restored[MAX_TOPICS];
+    int restored_count = 0;
+    int last_ticks = 0;
+    int batches = 0;
+    size_t pos = 0;
+
+    while (pos + sizeof(SnapBatch) <= (size_t)st.st_size) {
+        SnapBatch batch;
+        memcpy(&batch, data + pos, sizeof(batch));
+        if (batch.magic != SNAP_MAGIC) {
+            break;
+        }
+
+        // Validar o lote inteiro antes de o aplicar
+        size_t end = pos + sizeof(batch);
+        int valid = 1;
+        for (int i = 0; i < batch.record_count && valid; i++) {
+            SnapRecord record;
+            if (end + sizeof(record) > (size_t)st.st_size) {
+                valid = 0;
+                break;
+            }
+            memcpy(&record, data + end, sizeof(record));
+            end += sizeof(record);
+            for (int j = 0; j < record.msg_count && valid; j++) {
+                Message header;
+                if (end + FRAME_HEADER_SIZE > (size_t)st.st_size) {
+                    valid = 0;
+                    break;
+                }
+                memcpy(&header, data + end, FRAME_HEADER_SIZE);
+                if (header.body_len > MAX_MSG_BODY || end + FRAME_HEADER_SIZE + header.body_len > (size_t)st.st_size) {
+                    valid = 0;
+                    break;
+                }
+                end += FRAME_HEADER_SIZE + header.body_len;
+            }
+        }
+        if (!valid) {
+            printf("Aviso: Último lote do snapshot incompleto, ignorado.\n");
+            break;
+        }
+
+        pos += sizeof(batch);
+        for (int i = 0; i < batch.record_count; i++) {
+            SnapRecord record;
+            memcpy(&record, data + pos, sizeof(record));
+            pos += sizeof(record);
+            record.name[MAX_TOPIC_NAME - 1] = '\0';
+            if (record.sub_count > MAX_FEEDS) record.sub_count = MAX_FEEDS;
+            if (record.msg_count > 5) record.msg_count = 5;
+
+            int index = 0;
+            while (index < restored_count && strcmp(restored[index].record.name, record.name) != 0) {
+                index++;
+            }
+            if (index == restored_count) {
+                if (restored_count >= MAX_TOPICS) {
+                    continue;
+                }
+                restored_count++;
+            } else {
+                free_topic_copies(&restored[index], 1);
+            }
+
+            restored[index].record = record;
+            for (int j = 0; j < record.msg_count; j++) {
+                Message frame;
+                memcpy(&frame, data + pos, FRAME_HEADER_SIZE);
+                memcpy(frame.body, data + pos + FRAME_HEADER_SIZE, frame.body_len);
+                frame.body[frame.body_len] = '\0';
+                pos += FRAME_HEADER_SIZE + frame.body_len;
+                restored[index].messages[j] = message_clone(&frame);
+            }
+        }
+        last_ticks = batch.ticks;
+        batches++;
+    }
+    free(data);
+
+    int applied = 0;
+    pthread_mutex_lock(&state->lock);
+    for (int i = 0; i < restored_count; i++) {
+        SnapRecord *record = &restored[i].record;
+        Topic *topic = find_topic(state, record->name);
+
+        if (record->kind == SNAP_TOMBSTONE) {
+            if (topic) {
+                destroy_topic(state, (int)(topic - state->topics));
+            }
+            continue;
+        }
+
+        if (!topic) {
+            topic = get_or_create_topic(state, record->name);
+        }
+        if (!topic) {
+            printf("Erro: Limite de tópicos atingido ao recuperar o tópico '%s'.\n", record->name);
+            free_topic_copies(&restored[i], 1);
+            continue;
+        }
+
+        for (int j = 0; j < topic->msg_count; j++) {
+            free(topic->messages[j]);
+        }
+        topic->msg_count = 0;
+        __atomic_store_n(&topic->flags->locked, record->is_locked, __ATOMIC_RELEASE);
+        topic->compress = record->compress;
+        topic->last_seq = record->last_seq;
+        topic->session_count = record->sub_count;
+        for (int j = 0; j < record->sub_count; j++) {
+            strncpy(topic->sessions[j].username, record->subscribers[j], 50);
+            topic->sessions[j].username[49] = '\0';
+            topic->sessions[j].last_seq = record->subscriber_seq[j];
+            memcpy(topic->sessions[j].filter, record->subscriber_filter[j], MAX_FILTER_LEN);
+            topic->sessions[j].filter[MAX_FILTER_LEN - 1] = '\0';
+            topic->sessions[j].saved_tick = state->ticks;
+        }
+
+        // O tempo restante conta a partir do último lote gravado
+        for (int j = 0; j < record->msg_count; j++) {
+            Message *msg = restored[i].messages[j];
+            if (!msg) {
+                continue;
+            }
+            int remaining_time = msg->duration - (last_ticks - msg->created_time);
+            if (remaining_time <= 0) {
+                free(msg);
+                continue;
+            }
+            msg->duration = remaining_time;
+            msg->created_time = state->ticks;
+            topic->messages[topic->msg_count++] = msg;
+        }
+        applied++;
+    }
+    pthread_mutex_unlock(&state->lock);
+
+    if (batches > 0) {
+        printf("Estado recuperado do snapshot '%s' (%d tópicos).\n", state->snapshot_path, applied);
+    }
+}
+
+// Um corpo só vai tal e qual para o ficheiro de persistência se sobreviver à leitura com
+// sscanf: texto de uma linha, sem NUL nem caracteres de controlo e sem espaços nas pontas
+int plain_text_body(const Message *msg) {
+    if (msg->body_len == 0 || msg->body[0] == ' ' || msg->body[msg->body_len - 1] == ' ') {
+        return 0;
+    }
+    for (int i = 0; i < msg->body_len; i++) {
+        unsigned char c = (unsigned char)msg->body[i];
+        if (c < 0x20 || c == 0x7f) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void save_persistent_messages(ManagerState *state) {
+    const char *filename = getenv("MSG_FICH");
+    if (!filename) {
+        printf("Erro: Variável de ambiente MSG_FICH não definida.\n");
+        return;
+    }
+
+    // Copiar o estado sob o lock e escrever o ficheiro depois, sem bloquear a publicação
+    TopicCopy copies[MAX_TOPICS];
+    pthread_mutex_lock(&state->lock);
+    int ticks = state->ticks;
+    int count = copy_topics(state, copies, 0);
+    pthread_mutex_unlock(&state->lock);
+
+    FILE *file = fopen(filename, "w");
+    if (!file) {
+        perror("Erro ao abrir ficheiro para salvar mensagens");
+        free_topic_copies(copies, count);
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        for (int j = 0; j < copies[i].record.msg_count; j++) {
+            Message *msg = copies[i].messages[j];
+            int remaining_time = msg->duration - (ticks - msg->created_time);
+
+            if (remaining_time <= 0) {
+                continue;
+            }
+
+            if (msg->flags & FRAME_COMPRESSED) {
+                // Corpo comprimido: "<restante>:z<tamanho original>" seguido do corpo em base64
+                char encoded[BASE64_LEN(MAX_MSG_BODY) + 1];
+                base64_encode((const unsigned char *)msg->body, msg->body_len, encoded);
+                fprintf(file, "%s %s %d:z%d %s\n", 
+                        copies[i].record.name, 
+                        msg->username, 
+                        remaining_time, 
+                        msg->raw_len,
+                        encoded);
+            } else if (!plain_text_body(msg)) {
+                // Corpo com quebras de linha, NUL ou espaços nas pontas: "<restante>:b<tamanho>"
+                // seguido do corpo em base64, para não partir a linha do ficheiro
+                char encoded[BASE64_LEN(MAX_MSG_BODY) + 1];
+                base64_encode((const unsigned char *)msg->body, msg->body_len, encoded);
+                fprintf(file, "%s %s %d:b%d %s\n", 
+                        copies[i].record.name, 
+                        msg->username, 
+                        remaining_time, 
+                        msg->body_len,
+                        encoded);
+            } else {
+                fprintf(file, "%s %s %d %s\n", 
+                        copies[i].record.name, 
+                        msg->username, 
+                        remaining_time, 
+                        msg->body);
+            }
+        }
+    }
+
+    fclose(file);
+    free_topic_copies(copies, count);
+
+    printf("Mensagens persistentes salvas no '%s'.\n", filename);
+}
+
+void load_persistent_messages(ManagerState *state) {
+    const char *filename = getenv("MSG_FICH");
+    if (!filename) {
+        printf("Erro: Variável de ambiente MSG_FICH não definida.\n");
+        return;
+    }
+
+    FILE *file = fopen(filename, "r");
+    if (!file) {
+        perror("Erro ao abrir ficheiro para carregar mensagens");
+        return;
+    }
+
+    pthread_mutex_lock(&state->lock);
+
+    char line[BASE64_LEN(MAX_MSG_BODY) + 128];
+    while (fgets(line, sizeof(line), file)) {
+        char topic_name[MAX_TOPIC_NAME];
+        char username[50];
+        char remaining_field[24];
+        char body[BASE64_LEN(MAX_MSG_BODY) + 1];
+
+        // Ler os campos do ficheiro (um corpo codificado vazio não tem o quarto campo)
+        body[0] = '\0';
+        int fields = sscanf(line, "%19s %49s %23s %[^\n]", topic_name, username, remaining_field, body);
+        if (fields < 3) {
+            printf("Erro: Linha inválida no ficheiro: %s\n", line);
+            continue;
+        }
+
+        char *suffix;
+        int remaining_time = (int)strtol(remaining_field, &suffix, 10);
+        if (fields == 3 && strcmp(suffix, ":b0") != 0) {
+            printf("Erro: Linha inválida no ficheiro: %s\n", line);
+            continue;
+        }
+
+        Message loaded = {0};
+        strncpy(loaded.topic, topic_name, sizeof(loaded.topic));
+        strncpy(loaded.username, username, sizeof(loaded.username));
+
+        if (strncmp(suffix, ":z", 2) == 0) {
+            int len = base64_decode(body, (unsigned char *)loaded.body, MAX_MSG_BODY);
+            if (len < 0) {
+                printf("Erro: Linha inválida no ficheiro: %s\n", line);
+                continue;
+            }
+            loaded.body_len = (unsigned short)len;
+            loaded.raw_len = (unsigned short)atoi(suffix + 2);
+            loaded.flags = FRAME_COMPRESSED;
+        } else if (strncmp(suffix, ":b", 2) == 0) {
+            int len = base64_decode(body, (unsigned char *)loaded.body, MAX_MSG_BODY);
+            if (len < 0 || len != atoi(suffix + 2)) {
+                printf("Erro: Linha inválida no ficheiro: %s\n", line);
+                continue;
+            }
+            loaded.body[len] = '\0';
+            loaded.body_len = (unsigned short)len;
+            loaded.raw_len = (unsigned short)len;
+        } else {
+            message_set_body(&loaded, body);
+        }
+
+        // Encontrar ou criar o tópico
+        Topic *topic = get_or_create_topic(state, topic_name);
+        if (!topic) {
+            printf("Erro: Limite de tópicos atingido ao carregar mensagem do tópico '%s'.\n", topic_name);
+            continue;
+        }
+
+        // Um tópico com mensagens comprimidas continua com a compressão ativa
+        if (loaded.flags & FRAME_COMPRESSED) {
+            topic->compress = COMPRESS_LZ;
+        }
+
+        // Adicionar a mensagem ao tópico
+        if (topic->msg_count < 5) {
+            loaded.duration = remaining_time;
+
+            // Ajustar o tempo de criação com base no `ticks` atual
+            loaded.created_time = state->ticks;
+            loaded.seq = ++topic->last_seq;
+
+            Message *msg = message_clone(&loaded);
+            if (msg) {
+                topic->messages[topic->msg_count++] = msg;
+            }
+        } else {
+            printf("Erro: Limite de mensagens atingido no tópico '%s'.\n", topic_name);
+        }
+    }
+
+    pthread_mutex_unlock(&state->lock);
+    fclose(file);
+
+    printf("Mensagens persistentes recuperadas de '%s'.\n", filename);
+}
+
+
+
+// Lê a próxima trama de uma gravação. Devolve 1, 0 no fim do ficheiro ou -1 se estiver truncada.
+int replay_read(FILE *file, RecordEntry *entry, Message *msg) {
+    long pos = ftell(file);
+    if (fread(entry, sizeof(*entry), 1, file) != 1) {
+        return ftell(file) == pos && !ferror(file) ? 0 : -1;
+    }
+    if (entry->len < FRAME_HEADER_SIZE || entry->len > FRAME_HEADER_SIZE + MAX_MSG_BODY ||
+        fread(msg, entry->len, 1, file) != 1 || msg->body_len != entry->len - FRAME_HEADER_SIZE) {
+        return -1;
+    }
+    msg->body[msg->body_len] = '\0';
+    return 1;
+}
+
+// Espera que o despacho termine as primeiras count tramas injetadas
+void replay_wait_dispatched(ManagerState *state, unsigned long long count) {
+    while (__atomic_load_n(&state->replay_hist->total, __ATOMIC_RELAXED) < count) {
+        sched_yield();
+    }
+}
+
+// Coloca uma trama gravada na fila de entrada, marcada para medir a latência do despacho.
+// À velocidade máxima as tramas de controlo só entram com o despacho em dia (senão um EXIT
+// ultrapassaria as mensagens do mesmo feed, que estão noutra fila) e as restantes esperam que
+// a fila da classe desça abaixo do limiar de sobrecarga, para se medir o despacho e não o descarte.
+int replay_inject(ManagerState *state, Message *msg, int realtime, unsigned long long injected) {
+    if (!realtime) {
+        int qos = classify_frame(msg);
+        if (qos == QOS_CONTROL) {
+            replay_wait_dispatched(state, injected);
+        }
+        pthread_mutex_lock(&state->queue_lock);
+        while (100 * (state->inbound[qos].count + 1) / QUEUE_CAPACITY >= OVERLOAD_HIGH_PCT) {
+            pthread_cond_wait(&state->queue_ready, &state->queue_lock);
+        }
+        pthread_mutex_unlock(&state->queue_lock);
+    }
+
+    msg->flags |= FRAME_TRACED;
+    msg->t_publish = monotonic_ns();
+    return enqueue_inbound(state, msg);
+}
+
+// Espera que todas as tramas injetadas tenham sido despachadas e entregues aos feeds
+void replay_drain(ManagerState *state, unsigned long long injected) {
+    replay_wait_dispatched(state, injected);
+
+    int pending = 1;
+    while (pending) {
+        pending = 0;
+        pthread_mutex_lock(&state->lock);
+        for (int i = 0; i < state->feed_count; i++) {
+            for (int qos = 0; qos < QOS_COUNT; qos++) {
+                pending += state->feeds[i].out[qos].count;
+            }
+        }
+        pthread_mutex_unlock(&state->lock);
+        if (pending) {
+            sched_yield();
+        }
+    }
+}
+
+// Reproduz uma gravação de MANAGER_RECORD na lógica de despacho, com os feeds ligados a
+// /dev/null, à velocidade máxima ou ao ritmo gravado. O estado começa vazio (MSG_FICH é
+// ignorada) para que a mesma gravação dê sempre o mesmo resultado.
+int run_replay(ManagerState *state, const char *path, int realtime) {
+    FILE *file = fopen(path, "rb");
+    unsigned int magic = 0;
+    if (!file) {
+        perror("Erro ao abrir gravação");
+        return EXIT_FAILURE;
+    }
+    if (fread(&magic, sizeof(magic), 1, file) != 1 || magic != RECORD_MAGIC) {
+        fprintf(stderr, "Erro: '%s' não é uma gravação do manager.\n", path);
+        fclose(file);
+        return EXIT_FAILURE;
+    }
+
+    state->replay = 1;
+    state->replay_hist = calloc(1, sizeof(Histogram));
+    if (!state->replay_hist) {
+        perror("Erro ao reservar histograma");
+        fclose(file);
+        return EXIT_FAILURE;
+    }
+
+    pthread_t delivery_thread, command_thread;
+    if (pthread_create(&delivery_thread, NULL, deliver_feeds_thread, state) != 0 ||
+        pthread_create(&command_thread, NULL, process_commands_thread, state) != 0) {
+        perror("Erro ao criar threads da reprodução");
+        fclose(file);
+        return EXIT_FAILURE;
+    }
+
+    RecordEntry entry;
+    Message msg;
+    unsigned long long read_count = 0, injected = 0;
+    long long first_ns = 0, span_ns = 0;
+    long long start_ns = monotonic_ns();
+    int result;
+
+    while ((result = replay_read(file, &entry, &msg)) == 1) {
+        if (read_count++ == 0) {
+            first_ns = entry.t_ns;
+        }
+        span_ns = entry.t_ns - first_ns;
+
+        if (realtime) {
+            long long due = start_ns + span_ns;
+            struct timespec ts = {due / 1000000000LL, due % 1000000000LL};
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+            }
+        }
+
+        if (replay_inject(state, &msg, realtime, injected) == 0) {
+            injected++;
+        }
+    }
+    fclose(file);
+    if (result < 0) {
+        fprintf(stderr, "Aviso: gravação truncada após %llu tramas.\n", read_count);
+    }
+
+    replay_drain(state, injected);
+    long long elapsed_ns = monotonic_ns() - start_ns;
+
+    pthread_mutex_lock(&state->queue_lock);
+    state->running = 0;
+    pthread_cond_broadcast(&state->queue_ready);
+    pthread_mutex_unlock(&state->queue_lock);
+    wake_delivery(state);
+    pthread_join(command_thread, NULL);
+    pthread_join(delivery_thread, NULL);
+
+    // O relatório vai para stderr: o stdout leva as linhas de cada comando despachado
+    char summary[256];
+    double seconds = elapsed_ns / 1e9;
+    fprintf(stderr, "\nReprodução de '%s' (%s): %llu tramas em %.3f s (gravadas em %.3f s), %.0f tramas/s\n",
+            path, realtime ? "ritmo gravado" : "velocidade máxima", read_count, seconds,
+            span_ns / 1e9, seconds > 0 ? read_count / seconds : 0.0);
+    fprintf(stderr, "Descartadas por sobrecarga: %lld\n", state->shed_count);
+    hist_format(state->replay_hist, summary, sizeof(summary));
+    fprintf(stderr, "Despacho: %s\n", summary);
+    for (int i = 0; i < state->topic_count; i++) {
+        if (state->topics[i].fanout_hist) {
+            hist_format(state->topics[i].fanout_hist, summary, sizeof(summary));
+            fprintf(stderr, "Distribuição '%s': %s\n", state->topics[i].name, summary);
+        }
+    }
+
+    free(state->replay_hist);
+    state->replay_hist = NULL;
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+    int manager_fd;
+    ManagerState state;
+
+    init_manager_state(&state);
+
+    // Colocação das threads (MANAGER_CPUS) e espera ativa do despacho (MANAGER_SPIN_US)
+    if (getenv("MANAGER_CPUS")) {
+        load_cpu_config(&state, getenv("MANAGER_CPUS"));
+        report_cpu_placement(&state);
+    }
+    if (getenv("MANAGER_SPIN_US")) {
+        state.spin_max_ns = atoll(getenv("MANAGER_SPIN_US")) * 1000LL;
+    }
+
+    // ./manager --replay <gravação> [--realtime]: reproduzir tramas gravadas com MANAGER_RECORD
+    if (argc >= 3 && strcmp(argv[1], "--replay") == 0) {
+        signal(SIGPIPE, SIG_IGN);
+        return run_replay(&state, argv[2], argc >= 4 && strcmp(argv[3], "--realtime") == 0);
+    }
+    if (argc > 1) {
+        fprintf(stderr, "Uso: %s [--replay <gravação> [--realtime]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // Configurar manipulador de sinal
+    signal(SIGINT, sigint_handler);
+
+    // Escritas para feeds que já fecharam devolvem EPIPE em vez de terminar o processo
+    signal(SIGPIPE, SIG_IGN);
+
+    // Inicializar o contador de ticks
+    state.ticks = 0;
+
+    // Recuperar mensagens persistentes do ficheiro (se existir) e o diário de snapshots
+    load_persistent_messages(&state);
+    if (getenv("MSG_FICH")) {
+        snprintf(state.snapshot_path, sizeof(state.snapshot_path), "%s.snap", getenv("MSG_FICH"));
+        load_snapshot(&state);
+    }
+    if (getenv("MANAGER_RECORD")) {
+        open_record(&state, getenv("MANAGER_RECORD"));
+    }
+
+    // Criar o pipe principal
+    if (mkfifo(MANAGER_PIPE, 0666) == -1) {
+        perror("Erro ao criar pipe do manager");
+        return EXIT_FAILURE;
+    }
+
+    // Abrir o pipe principal em leitura e escrita para evitar bloqueios
+    manager_fd = open(MANAGER_PIPE, O_RDWR);
+    if (manager_fd == -1) {
+        perror("Erro ao abrir pipe do manager");
+        unlink(MANAGER_PIPE);
+        return EXIT_FAILURE;
+    }
+
+    printf("Manager iniciado. Aguardando conexões...\n");
+
+    // Iniciar a thread para comandos administrativos
+    pthread_t admin_thread;
+    if (pthread_create(&admin_thread, NULL, admin_commands, &state) != 0) {
+        perror("Erro ao criar thread administrativa");
+        close(manager_fd);
+        unlink(MANAGER_PIPE);
+        return EXIT_FAILURE;
+    }
+
+    // Iniciar a thread para monitorar mensagens persistentes
+    pthread_t monitor_thread;
+    if (pthread_create(&monitor_thread, NULL, monitor_persistent_messages, &state) != 0) {
+        perror("Erro ao criar thread de monitorização");
+        close(manager_fd);
+        unlink(MANAGER_PIPE);
+        return EXIT_FAILURE;
+    }
+
+    // Iniciar a thread que gere ligações pendentes e meio-abertas
+    pthread_t connections_thread;
+    if (pthread_create(&connections_thread, NULL, monitor_connections, &state) != 0) {
+        perror("Erro ao criar thread de ligações");
+        close(manager_fd);
+        unlink(MANAGER_PIPE);
+        return EXIT_FAILURE;
+    }
+
+    // Iniciar a thread que grava snapshots incrementais do estado
+    pthread_t snap_thread;
+    if (pthread_create(&snap_thread, NULL, snapshot_thread, &state) != 0) {
+        perror("Erro ao criar thread de snapshots");
+        close(manager_fd);
+        unlink(MANAGER_PIPE);
+        return EXIT_FAILURE;
+    }
+
+    // Iniciar a thread que entrega as tramas aos feeds
+    pthread_t delivery_thread;
+    if (pthread_create(&delivery_thread, NULL, deliver_feeds_thread, &state) != 0) {
+        perror("Erro ao criar thread de entrega");
+        close(manager_fd);
+        unlink(MANAGER_PIPE);
+        return EXIT_FAILURE;
+    }
+
+    // Iniciar a thread que processa as tramas por classe de serviço
+    pthread_t command_thread;
+    if (pthread_create(&command_thread, NULL, process_commands_thread, &state) != 0) {
+        perror("Erro ao criar thread de processamento de comandos");
+        close(manager_fd);
+        unlink(MANAGER_PIPE);
+        return EXIT_FAILURE;
+    }
+
+    // Iniciar a thread para ler mensagens do pipe
+    pthread_t reader_thread;
+    struct {
+        int fd;
+        ManagerState *state;
+    } params = {manager_fd, &state};
+
+    if (pthread_create(&reader_thread, NULL, read_commands_thread, &params) != 0) {
+        perror("Erro ao criar thread de leitura de comandos");
+        close(manager_fd);
+        unlink(MANAGER_PIPE);
+        return EXIT_FAILURE;
+    }
+
+    // Esperar a thread administrativa encerrar
+    pthread_join(admin_thread, NULL);
+    state.running = 0; // Sinalizar para as threads secundárias pararem
+
+    // Esperar as threads secundárias encerrarem
+    pthread_join(monitor_thread, NULL);
+    pthread_join(connections_thread, NULL);
+    pthread_join(reader_thread, NULL);
+    pthread_join(command_thread, NULL);
+    pthread_join(delivery_thread, NULL);
+    pthread_join(snap_thread, NULL);
+
+    // Salvar mensagens persistentes antes de encerrar e compactar o diário
+    save_persistent_messages(&state);
+    state.snapshot_full = 1;
+    write_snapshot(&state);
+    if (state.snapshot_fd != -1) {
+        close(state.snapshot_fd);
+    }
+    if (state.record_file) {
+        fclose(state.record_file);
+    }
+
+    // Encerrar o manager
+    close(manager_fd);
+    unlink(MANAGER_PIPE);
+
+    pthread_mutex_destroy(&state.lock);
+    pthread_mutex_destroy(&state.queue_lock);
+    pthread_cond_destroy(&state.queue_ready);
+    close(state.wake_fds[0]);
+    close(state.wake_fds[1]);
+    printf("Manager encerrado.\n");
+
+    return EXIT_SUCCESS;
+}
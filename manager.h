@@ -1,56 +1,291 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <unistd.h>
-#include <fcntl.h>
-#include <pthread.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <time.h>
-#include <signal.h>
-
-#define MAX_FEEDS 10
-#define MAX_TOPICS 20
-#define MAX_TOPIC_NAME 20
-#define MAX_MSG_BODY 300
-#define MANAGER_PIPE "/tmp/manager_pipe" // Pipe principal para comunicação com feeds
-
-typedef struct {
-    char action[10];              // Tipo de ação ("INIT", "MSG", "SUB", "UNSUB", "EXIT")
-    char topic[MAX_TOPIC_NAME];   // Nome do tópico
-    char username[50];            // Nome do utilizador
-    char body[MAX_MSG_BODY];      // Corpo da mensagem
-    int duration;                 // Duração (segundos)
-    int created_time;             // Tempo de criação em "ticks"
-} Message;
-
-
-typedef struct {
-    char username[50];
-    char pipe_name[100];
-    int pipe_fd;
-} Feed;
-
-typedef struct {
-    char name[MAX_TOPIC_NAME];
-    int locked;
-    Feed *subscribers[MAX_FEEDS]; // Lista de feeds subscritos
-    int sub_count;
-    Message messages[5];          // Mensagens persistentes
-    int msg_count;
-    int is_locked;
-} Topic;
-
-typedef struct {
-    Feed feeds[MAX_FEEDS];
-    int feed_count;
-    Topic topics[MAX_TOPICS];
-    int topic_count;
-    pthread_mutex_t lock;
-    int running; // Flag para encerrar as threads
-    int ticks;   // Contador global de "ticks"
-} ManagerState;
-
-
-
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <signal.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sched.h>
+#include <dirent.h>
+#include <sys/syscall.h>
+#include "protocol.h"
+#include "codec.h"
+#include "filter.h"
+#include "hist.h"
+
+#define MAX_FEEDS 10
+#define MAX_TOPICS 20
+#define MAX_PENDING 32                    // Ligações à espera que o feed abra o seu pipe
+#define CONNECT_TIMEOUT_MS 3000           // Tempo máximo para concluir o handshake
+#define REAPER_INTERVAL_MS 20             // Período da thread de gestão de ligações
+#define MAX_STREAMS 16                    // Mensagens longas em curso em simultâneo
+#define MAX_SHED_STREAMS 16               // Mensagens longas descartadas por sobrecarga, lembradas até ao último bloco
+#define STREAM_IDLE_MS 5000               // Mensagem longa sem blocos durante este tempo é descartada
+#define SESSION_TTL_TICKS 3600            // Ticks durante os quais a sessão de um feed desligado é guardada
+#define MAX_LIMITS 64                     // Limites de envio por utilizador/tópico
+#define MAX_INHERITED_LIMITS (MAX_FEEDS + MAX_TOPICS) // Baldes próprios copiados do limite "*"
+#define LIMIT_NOTICE_NS 1000000000LL      // Intervalo mínimo entre avisos de limite ao mesmo feed
+#define OVERLOAD_HIGH_PCT 50              // Ocupação da fila da classe a partir da qual se descartam mensagens sem retenção
+#define OVERLOAD_CRITICAL_PCT 75          // Ocupação a partir da qual se descartam todas as mensagens da classe
+#define QUEUE_CAPACITY 128                // Tramas por fila (uma fila por classe de serviço)
+#define DISPATCH_POLL_MS 100              // Período máximo de espera das threads de leitura e entrega
+#define SNAPSHOT_INTERVAL_MS 1000         // Período dos snapshots incrementais do estado
+#define SNAPSHOT_COMPACT_BYTES (1 << 20)  // Tamanho do diário a partir do qual é compactado
+#define SNAP_MAGIC 0x33504e53             // "SNP3": início de cada lote do diário
+#define SNAP_TOPIC 1                      // Registo com o estado completo de um tópico
+#define SNAP_TOMBSTONE 2                  // Registo de um tópico removido
+#define RCU_READERS 2                     // Threads que leem o diretório de tópicos sem o lock
+#define RCU_ADMIN 0                       // Entrada da thread administrativa em rcu_active
+#define RCU_DISPATCH 1                    // Entrada da thread de despacho
+#define RCU_MAX_RETIRED 64                // Objetos retirados à espera de poderem ser libertados
+#define RECORD_MAGIC 0x3143524d           // "MRC1": início de um ficheiro de gravação (MANAGER_RECORD)
+#define RECORD_FLUSH_FRAMES 256           // Tramas gravadas entre escritas para o disco
+#define MAX_THREADS 8                     // Threads do manager registadas (comando threads)
+#define SPIN_DEFAULT_US 50                // Espera ativa máxima do despacho antes de dormir (MANAGER_SPIN_US)
+#define SPIN_MIN_NS 1000                  // Espera ativa mínima enquanto o despacho estiver ocioso
+#define BASE64_LEN(n) ((((n) + 2) / 3) * 4)   // Tamanho em base64 de n bytes
+
+// Fila circular de tramas (alocadas com message_clone)
+typedef struct {
+    Message *frames[QUEUE_CAPACITY];
+    int head;
+    int count;
+} FrameQueue;
+
+typedef struct {
+    char username[50];
+    char pipe_name[100];
+    int pipe_fd;                  // Não bloqueante: escrito pela thread de entrega
+    int accepts_compressed;       // O feed indicou FRAME_ACCEPTS_COMPRESSED no INIT
+    FrameQueue out[QOS_COUNT];    // Tramas por entregar, por classe de serviço
+    int credits[QOS_COUNT];       // Créditos do escalonamento ponderado
+    long long dropped;            // Tramas descartadas por fila cheia
+    long long overload_notice_ns; // Último aviso de sobrecarga enviado ao feed
+} Feed;
+
+// Ligação anunciada por INIT cujo pipe ainda não tem leitor
+typedef struct {
+    char username[50];
+    char pipe_name[100];
+    int flags;                    // Flags do INIT
+    long long deadline_ms;        // Instante (monotónico) em que a ligação expira
+} PendingFeed;
+
+// Ligação recusada antes de o feed abrir o pipe: o descritor segura a resposta no pipe
+typedef struct {
+    int fd;
+    long long deadline_ms;
+} RejectedFeed;
+
+// Balde de tokens: "rate" tokens por segundo, até "burst" acumulados
+typedef struct {
+    double rate;
+    double burst;
+    double tokens;
+    long long last_ns;
+} TokenBucket;
+
+#define LIMIT_USER  0
+#define LIMIT_TOPIC 1
+
+// Limite de envio de um utilizador ou tópico. O nome "*" aplica-se a quem não tem limite próprio.
+typedef struct {
+    int kind;                     // LIMIT_USER ou LIMIT_TOPIC
+    char name[50];
+    int inherited;                // Criado a partir do limite "*"
+    TokenBucket bucket;
+    long long rejected;           // Mensagens rejeitadas por este limite
+    long long last_notice_ns;     // Último aviso enviado ao feed
+} RateLimit;
+
+// Mensagem longa em curso: só guarda o destino, os blocos não são acumulados
+typedef struct {
+    char username[50];
+    unsigned int stream_id;
+    char topic[MAX_TOPIC_NAME];
+    long long last_ms;            // Instante do último bloco recebido
+} ActiveStream;
+
+// Mensagem longa cujo primeiro bloco foi descartado por sobrecarga: os blocos seguintes
+// são descartados à entrada, sem ocupar a fila
+typedef struct {
+    char username[50];
+    unsigned int stream_id;
+} ShedStream;
+
+// Sessão de um feed desligado: a subscrição é reposta quando voltar a ligar-se
+typedef struct {
+    char username[50];
+    unsigned int last_seq;        // Última mensagem do tópico entregue ao feed
+    char filter[MAX_FILTER_LEN];  // Filtro da subscrição
+    int saved_tick;               // Tick em que a sessão foi guardada (expira com SESSION_TTL_TICKS)
+} TopicSession;
+
+// Estado de um tópico que se lê e altera sem state->lock, com operações atómicas.
+// Não muda de endereço quando o tópico muda de posição em state->topics.
+typedef struct {
+    int locked;                   // Tópico bloqueado pelo administrador
+} TopicFlags;
+
+// Diretório imutável nome -> flags, publicado com um ponteiro atómico (estilo RCU).
+// É substituído sempre que um tópico é criado ou removido.
+typedef struct {
+    char name[MAX_TOPIC_NAME];
+    TopicFlags *flags;
+} TopicDirEntry;
+
+typedef struct {
+    int count;
+    TopicDirEntry entries[];
+} TopicDir;
+
+typedef struct {
+    char name[MAX_TOPIC_NAME];
+    TopicFlags *flags;            // Bloqueio do tópico (ver topic_is_locked)
+    Feed *subscribers[MAX_FEEDS]; // Lista de feeds subscritos
+    unsigned int sub_seq[MAX_FEEDS]; // Última mensagem enfileirada para cada subscritor
+    char sub_filter[MAX_FEEDS][MAX_FILTER_LEN]; // Filtro de cada subscritor (vazio: todas as mensagens)
+    Filter filters[MAX_FEEDS];    // Filtros compilados sobre o matcher do tópico
+    Matcher matcher;              // Padrões de todos os filtros do tópico
+    int filtered;                 // Há pelo menos um subscritor com filtro
+    long long filtered_out;       // Entregas evitadas pelos filtros
+    Histogram *fanout_hist;       // Saída da fila de entrada até à escrita no pipe do subscritor (FRAME_TRACED)
+    int sub_count;
+    Message *messages[5];         // Mensagens persistentes (alocadas com o tamanho da trama)
+    int msg_count;
+    int compress;                 // COMPRESS_NONE ou COMPRESS_LZ
+    long long bytes_raw;          // Bytes de corpo que seriam entregues sem compressão
+    long long bytes_out;          // Bytes de corpo efetivamente escritos nos pipes
+    long long codec_ns;           // Tempo de CPU gasto a comprimir
+    TopicSession sessions[MAX_FEEDS]; // Subscrições de feeds desligados
+    int session_count;
+    unsigned int last_seq;        // Último número de sequência atribuído
+    unsigned int version;         // Incrementado a cada alteração do tópico
+    unsigned int snap_version;    // Versão gravada no último snapshot
+    int snap_locked;              // Bloqueio gravado no último snapshot
+} Topic;
+
+// Cabeçalho de um lote do diário de snapshots (seguido de record_count registos)
+typedef struct {
+    unsigned int magic;
+    int ticks;                    // Ticks no momento do snapshot
+    int record_count;
+} SnapBatch;
+
+// Registo de um tópico no diário, seguido de msg_count tramas
+typedef struct {
+    unsigned char kind;           // SNAP_TOPIC ou SNAP_TOMBSTONE
+    unsigned char is_locked;
+    unsigned char compress;
+    unsigned char sub_count;
+    unsigned char msg_count;
+    char name[MAX_TOPIC_NAME];
+    unsigned int last_seq;
+    char subscribers[MAX_FEEDS][50];
+    unsigned int subscriber_seq[MAX_FEEDS];
+    char subscriber_filter[MAX_FEEDS][MAX_FILTER_LEN];
+} SnapRecord;
+
+// Cópia de um tópico tirada sob o lock, para ser gravada depois fora dele
+typedef struct {
+    SnapRecord record;
+    Message *messages[5];
+} TopicCopy;
+
+// Cabeçalho de cada trama gravada, seguido de len bytes (cabeçalho da trama + corpo)
+typedef struct {
+    long long t_ns;               // Instante da receção desde o início da gravação
+    unsigned int len;
+} RecordEntry;
+
+// Pausa dentro de uma espera ativa, para não roubar recursos ao outro hyperthread do núcleo
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_RELAX() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define CPU_RELAX() __asm__ __volatile__("yield" ::: "memory")
+#else
+#define CPU_RELAX() __asm__ __volatile__("" ::: "memory")
+#endif
+
+// Thread do manager em execução, para o relatório de tempo de CPU
+typedef struct {
+    char name[16];
+    pid_t tid;
+} ThreadInfo;
+
+// Contadores de uma thread lidos de /proc/self/task/<tid>
+typedef struct {
+    double user_ms;
+    double system_ms;
+    long voluntary;               // Trocas de contexto por a thread ter bloqueado
+    long involuntary;             // Trocas de contexto por o escalonador a ter interrompido
+    int last_cpu;
+} ThreadStats;
+
+// Conjunto de CPUs pedido em MANAGER_CPUS para uma thread ("*": todas as outras)
+typedef struct {
+    char name[16];
+    cpu_set_t cpus;
+} CpuRule;
+
+typedef struct {
+    Feed feeds[MAX_FEEDS];
+    int feed_count;
+    Topic topics[MAX_TOPICS];
+    int topic_count;
+    PendingFeed pending[MAX_PENDING];
+    int pending_count;
+    RejectedFeed rejected[MAX_PENDING];
+    int rejected_count;
+    ActiveStream streams[MAX_STREAMS];
+    int stream_count;
+    RateLimit limits[MAX_LIMITS];
+    int limit_count;
+    RateLimit inherited_limits[MAX_INHERITED_LIMITS]; // Um balde por feed ou tópico sem limite próprio
+    int inherited_count;
+    long long shed_count;         // Mensagens descartadas por sobrecarga
+    ShedStream shed_streams[MAX_SHED_STREAMS]; // Protegido por queue_lock
+    int shed_stream_count;
+    int shed_stream_next;         // Entrada reaproveitada com a tabela cheia
+    FrameQueue inbound[QOS_COUNT]; // Tramas recebidas por despachar, por classe de serviço
+    int inbound_credits[QOS_COUNT];
+    pthread_mutex_t queue_lock;   // Protege inbound
+    pthread_cond_t queue_ready;   // Sinaliza tramas em inbound (ou espaço na fila de controlo)
+    int inbound_pending;          // Tramas em inbound; lido sem lock na espera ativa do despacho
+    long long spin_max_ns;        // Limite da espera ativa do despacho (0: dormir logo)
+    int wake_fds[2];              // Pipe para acordar a thread de entrega
+    char removed_topics[MAX_TOPICS][MAX_TOPIC_NAME]; // Tópicos removidos desde o último snapshot
+    int removed_count;
+    int snapshot_full;            // O próximo snapshot tem de ser completo (compactação)
+    int snapshot_fd;              // Diário de snapshots (-1 se MSG_FICH não estiver definida)
+    char snapshot_path[256];
+    TopicDir *topic_dir;          // Diretório de tópicos atual (lido sem lock, ver rcu_read_lock)
+    unsigned long long rcu_epoch; // Época global, incrementada a cada objeto retirado
+    unsigned long long rcu_active[RCU_READERS]; // Época em que cada leitor entrou (0: fora de leitura)
+    void *retired[RCU_MAX_RETIRED]; // Objetos substituídos, libertados quando nenhum leitor os pode ver
+    unsigned long long retired_epoch[RCU_MAX_RETIRED];
+    int retired_count;
+    FILE *record_file;            // Gravação das tramas recebidas (NULL se MANAGER_RECORD não estiver definida)
+    long long record_start_ns;
+    int record_pending;           // Tramas gravadas desde a última escrita para o disco
+    int replay;                   // A reproduzir uma gravação: os feeds escrevem para /dev/null
+    Histogram *replay_hist;       // Na reprodução: tempo desde a injeção até ao fim do despacho
+    CpuRule cpu_rules[MAX_THREADS + 1];
+    int cpu_rule_count;
+    ThreadInfo threads[MAX_THREADS];
+    int thread_count;             // Protegido por lock
+    pthread_mutex_t lock;
+    int running; // Flag para encerrar as threads
+    int ticks;   // Contador global de "ticks"
+} ManagerState;
+
+
+
 ManagerState global_state;
\ No newline at end of file
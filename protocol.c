@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <unistd.h>
+#include "protocol.h"
+#include "codec.h"
+
+typedef struct {
+    const char *word;
+    unsigned char len;
+    unsigned char domain;
+    Opcode opcode;
+    const char *usage;
+} ProtocolVerb;
+
+// Tabela única, construída em tempo de compilação, usada para tramas e comandos de texto
+#define WIRE_VERB(op, word) {word, sizeof(word) - 1, DOM_WIRE, op, NULL},
+#define COMMAND_VERB(op, word, domain, usage) {word, sizeof(word) - 1, domain, op, usage},
+static const ProtocolVerb protocol_verbs[] = {
+    PROTOCOL_WIRE(WIRE_VERB)
+    PROTOCOL_COMMANDS(COMMAND_VERB)
+};
+#undef WIRE_VERB
+#undef COMMAND_VERB
+
+#define WIRE_NAME(op, word) [op] = word,
+static const char *const protocol_wire_names[OP_COUNT] = {
+    PROTOCOL_WIRE(WIRE_NAME)
+};
+#undef WIRE_NAME
+
+#define ERROR_NAME(code, name) [code] = name,
+static const char *const protocol_error_names[ERR_COUNT] = {
+    PROTOCOL_ERRORS(ERROR_NAME)
+};
+#undef ERROR_NAME
+
+#define PROTOCOL_VERB_COUNT (sizeof(protocol_verbs) / sizeof(protocol_verbs[0]))
+
+// Índice de acesso direto aos verbos, um por domínio: posição calculada a partir da palavra,
+// com sondagem linear nas colisões. Cada entrada guarda a posição em protocol_verbs mais 1.
+#define VERB_INDEX_SIZE 64
+#define VERB_DOMAINS 3
+static unsigned char protocol_verb_index[VERB_DOMAINS][VERB_INDEX_SIZE];
+
+static unsigned int protocol_hash(const char *word, size_t len) {
+    unsigned int hash = (unsigned int)len;
+    for (size_t i = 0; i < len; i++) {
+        hash = hash * 31 + (unsigned char)word[i];
+    }
+    return hash & (VERB_INDEX_SIZE - 1);
+}
+
+// Construído ao carregar o programa (ou a biblioteca), antes de haver threads
+__attribute__((constructor))
+static void protocol_build_index(void) {
+    _Static_assert(PROTOCOL_VERB_COUNT < VERB_INDEX_SIZE, "VERB_INDEX_SIZE demasiado pequeno");
+    for (size_t i = 0; i < PROTOCOL_VERB_COUNT; i++) {
+        const ProtocolVerb *verb = &protocol_verbs[i];
+        int domain = __builtin_ctz(verb->domain);
+        unsigned int slot = protocol_hash(verb->word, verb->len);
+        while (protocol_verb_index[domain][slot]) {
+            slot = (slot + 1) & (VERB_INDEX_SIZE - 1);
+        }
+        protocol_verb_index[domain][slot] = (unsigned char)(i + 1);
+    }
+}
+
+static const ProtocolVerb *protocol_lookup(const char *word, size_t len, int domain) {
+    unsigned int hash = protocol_hash(word, len);
+    for (int d = 0; d < VERB_DOMAINS; d++) {
+        if (!(domain & (1 << d))) {
+            continue;
+        }
+        for (unsigned int slot = hash; protocol_verb_index[d][slot]; slot = (slot + 1) & (VERB_INDEX_SIZE - 1)) {
+            const ProtocolVerb *verb = &protocol_verbs[protocol_verb_index[d][slot] - 1];
+            if (verb->len == len && memcmp(verb->word, word, len) == 0) {
+                return verb;
+            }
+        }
+    }
+    return NULL;
+}
+
+Opcode protocol_decode_action(const char action[ACTION_LEN]) {
+    const char *end = memchr(action, '\0', ACTION_LEN);
+    size_t len = end ? (size_t)(end - action) : ACTION_LEN;
+
+    const ProtocolVerb *verb = protocol_lookup(action, len, DOM_WIRE);
+    return verb ? verb->opcode : OP_UNKNOWN;
+}
+
+void protocol_set_action(Message *msg, Opcode opcode) {
+    memset(msg->action, 0, sizeof(msg->action));
+    if (opcode > OP_UNKNOWN && opcode < OP_COUNT && protocol_wire_names[opcode]) {
+        strncpy(msg->action, protocol_wire_names[opcode], sizeof(msg->action) - 1);
+    }
+}
+
+// Separa o verbo dos argumentos. Devolve 0 se o verbo for reconhecido no domínio pedido.
+int protocol_parse_command(const char *line, int domain, ParsedCommand *out) {
+    size_t len = strcspn(line, " \t");
+    const char *args = line + len;
+    while (*args == ' ' || *args == '\t') {
+        args++;
+    }
+
+    const ProtocolVerb *verb = protocol_lookup(line, len, domain);
+    out->opcode = verb ? verb->opcode : OP_UNKNOWN;
+    out->verb = verb ? verb->word : NULL;
+    out->usage = verb ? verb->usage : NULL;
+    out->args = args;
+    return verb ? 0 : -1;
+}
+
+// Lista de comandos de um domínio, separados por vírgulas (para mensagens de ajuda)
+const char *protocol_command_list(int domain) {
+    static char lists[(DOM_WIRE | DOM_CLIENT | DOM_ADMIN) + 1][256];
+    char *list = lists[domain & (DOM_WIRE | DOM_CLIENT | DOM_ADMIN)];
+
+    if (list[0] == '\0') {
+        for (size_t i = 0; i < PROTOCOL_VERB_COUNT; i++) {
+            if (protocol_verbs[i].domain & domain) {
+                if (list[0] != '\0') {
+                    strcat(list, ", ");
+                }
+                strcat(list, protocol_verbs[i].word);
+            }
+        }
+    }
+    return list;
+}
+
+const char *protocol_error_name(ErrorCode code) {
+    return code < ERR_COUNT ? protocol_error_names[code] : "DESCONHECIDO";
+}
+
+void message_set_body(Message *msg, const char *text) {
+    size_t len = strnlen(text, MAX_MSG_BODY);
+    memcpy(msg->body, text, len);
+    msg->body[len] = '\0';
+    msg->body_len = (unsigned short)len;
+    msg->raw_len = (unsigned short)len;
+    msg->flags &= ~FRAME_COMPRESSED;
+}
+
+void message_format_body(Message *msg, const char *fmt, ...) {
+    char text[MAX_MSG_BODY + 1];
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(text, sizeof(text), fmt, ap);
+    va_end(ap);
+
+    message_set_body(msg, text);
+}
+
+// Cópia alocada com o tamanho exato da trama (cabeçalho + corpo)
+Message *message_clone(const Message *msg) {
+    Message *copy = malloc(FRAME_HEADER_SIZE + msg->body_len + 1);
+    if (!copy) {
+        return NULL;
+    }
+
+    memcpy(copy, msg, FRAME_HEADER_SIZE + msg->body_len);
+    copy->body[copy->body_len] = '\0';
+    return copy;
+}
+
+// Copia uma trama (possivelmente alocada com message_clone) para um Message completo
+void message_copy(Message *dst, const Message *src) {
+    memcpy(dst, src, FRAME_HEADER_SIZE + src->body_len);
+    dst->body[dst->body_len] = '\0';
+}
+
+// Comprime o corpo no lugar. Devolve 1 se comprimiu, 0 se não compensou.
+int message_compress(Message *msg) {
+    if ((msg->flags & FRAME_COMPRESSED) || msg->body_len < COMPRESS_MIN_BODY) {
+        return 0;
+    }
+
+    unsigned char packed[MAX_MSG_BODY];
+    int len = codec_compress((const unsigned char *)msg->body, msg->body_len, packed, msg->body_len - 1);
+    if (len < 0) {
+        return 0;
+    }
+
+    memcpy(msg->body, packed, len);
+    msg->raw_len = msg->body_len;
+    msg->body_len = (unsigned short)len;
+    msg->flags |= FRAME_COMPRESSED;
+    return 1;
+}
+
+// Repõe o corpo original. Devolve 0 em caso de sucesso e -1 se os dados forem inválidos.
+int message_decompress(Message *msg) {
+    if (!(msg->flags & FRAME_COMPRESSED)) {
+        return 0;
+    }
+
+    unsigned char raw[MAX_MSG_BODY];
+    int len = codec_decompress((const unsigned char *)msg->body, msg->body_len, raw, sizeof(raw));
+    if (len < 0 || len != msg->raw_len) {
+        return -1;
+    }
+
+    memcpy(msg->body, raw, len);
+    msg->body[len] = '\0';
+    msg->body_len = (unsigned short)len;
+    msg->flags &= ~FRAME_COMPRESSED;
+    return 0;
+}
+
+// Escreve uma trama numa única chamada (atómica no pipe)
+ssize_t protocol_write_frame(int fd, const Message *msg) {
+    return write(fd, msg, FRAME_HEADER_SIZE + msg->body_len);
+}
+
+static int protocol_read_exact(int fd, void *buf, size_t len) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = read(fd, (char *)buf + done, len - done);
+        if (n == 0) {
+            return 0;
+        }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        done += n;
+    }
+    return 1;
+}
+
+// Lê uma trama completa. Devolve 1 se leu, 0 no fim do pipe e -1 em caso de erro.
+int protocol_read_frame(int fd, Message *msg) {
+    int result = protocol_read_exact(fd, msg, FRAME_HEADER_SIZE);
+    if (result <= 0) {
+        return result;
+    }
+
+    if (msg->body_len > MAX_MSG_BODY) {
+        errno = EPROTO;
+        return -1;
+    }
+
+    result = protocol_read_exact(fd, msg->body, msg->body_len);
+    if (result <= 0) {
+        return result;
+    }
+
+    msg->body[msg->body_len] = '\0';
+    return 1;
+}
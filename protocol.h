@@ -0,0 +1,172 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stddef.h>
+#include <limits.h>
+#include <sys/types.h>
+
+#define MAX_TOPIC_NAME 20
+#define MAX_MSG_BODY 3840                 // A trama completa cabe em PIPE_BUF (escrita atómica)
+#define MAX_STREAM_LEN (8 * 1024 * 1024)  // Tamanho máximo de uma mensagem enviada em blocos
+#define ACTION_LEN 10                     // Tamanho máximo para as strings de ação
+#define MANAGER_PIPE "/tmp/manager_pipe" // Pipe principal para comunicação entre feeds e manager
+
+// Flags das tramas
+#define FRAME_COMPRESSED         0x01 // O corpo segue comprimido (ver codec.h)
+#define FRAME_ACCEPTS_COMPRESSED 0x02 // Em INIT: o feed aceita receber corpos comprimidos
+#define FRAME_CHUNK              0x04 // Bloco de uma mensagem longa (ver stream_*)
+#define FRAME_LAST               0x08 // Último bloco da mensagem longa
+#define FRAME_TRACED             0x10 // Mensagem com marcas temporais t_* (CLOCK_MONOTONIC, ns)
+
+// Classes de serviço (QoS) transportadas em cada trama
+#define QOS_NORMAL  0 // Por omissão
+#define QOS_BULK    1 // Transferências em massa (ex.: mensagens longas)
+#define QOS_URGENT  2 // Mensagens urgentes dos feeds
+#define QOS_CONTROL 3 // Comandos de controlo e notificações do sistema (atribuída pelo manager)
+#define QOS_COUNT   4
+
+// Trama trocada nos pipes (igual nos dois binários). Só o cabeçalho e body_len
+// bytes do corpo seguem no pipe.
+typedef struct {
+    char action[ACTION_LEN];      // Tipo de ação ("INIT", "MSG", "SUB", "UNSUB", "EXIT", ...)
+    char topic[MAX_TOPIC_NAME];   // Nome do tópico
+    char username[50];            // Nome do utilizador
+    int duration;                 // Duração (segundos)
+    int created_time;             // Tempo de criação em "ticks" (preenchido pelo manager)
+    unsigned short body_len;      // Bytes do corpo presentes na trama
+    unsigned short raw_len;       // Tamanho do corpo depois de descomprimido
+    unsigned char flags;          // FRAME_*
+    unsigned char error;          // Em ERROR: código ERR_* do motivo
+    unsigned char priority;       // Classe de serviço QOS_*
+    unsigned int stream_id;       // Mensagem longa a que o bloco pertence (única por utilizador)
+    unsigned int stream_offset;   // Posição do bloco na mensagem longa
+    unsigned int stream_total;    // Tamanho total da mensagem longa
+    unsigned int seq;             // Número de sequência da mensagem no tópico (0 se não tiver)
+    long long t_publish;          // Com FRAME_TRACED: envio pelo feed
+    long long t_dequeue;          // Com FRAME_TRACED: saída da fila de entrada do manager
+    long long t_fanout;           // Com FRAME_TRACED: distribuição pelos subscritores
+    char body[MAX_MSG_BODY + 1];  // Corpo da mensagem (terminado em '\0' quando é texto)
+} Message;
+
+#define FRAME_HEADER_SIZE offsetof(Message, body)
+
+_Static_assert(FRAME_HEADER_SIZE + MAX_MSG_BODY <= PIPE_BUF, "Uma trama tem de caber numa escrita atómica");
+
+// Domínios onde uma palavra do protocolo é aceite
+#define DOM_WIRE   1 // Campo action das tramas
+#define DOM_CLIENT 2 // Comandos escritos no feed
+#define DOM_ADMIN  4 // Comandos do administrador no manager
+
+// Todos os opcodes conhecidos: X(opcode)
+#define PROTOCOL_OPCODES(X) \
+    X(OP_INIT)              \
+    X(OP_EXIT)              \
+    X(OP_MSG)               \
+    X(OP_SUB)               \
+    X(OP_UNSUB)             \
+    X(OP_FILE)              \
+    X(OP_URGENT)            \
+    X(OP_ACK)               \
+    X(OP_ERROR)             \
+    X(OP_USERS)             \
+    X(OP_REMOVE)            \
+    X(OP_TOPICS)            \
+    X(OP_SHOW)              \
+    X(OP_LOCK)              \
+    X(OP_UNLOCK)            \
+    X(OP_COMPRESS)          \
+    X(OP_LIMIT)             \
+    X(OP_LIMITS)            \
+    X(OP_LATENCY)           \
+    X(OP_THREADS)           \
+    X(OP_CLOSE)
+
+// Palavras usadas no campo action das tramas: X(opcode, palavra)
+#define PROTOCOL_WIRE(X)   \
+    X(OP_INIT,  "INIT")    \
+    X(OP_EXIT,  "EXIT")    \
+    X(OP_MSG,   "MSG")     \
+    X(OP_SUB,   "SUB")     \
+    X(OP_UNSUB, "UNSUB")   \
+    X(OP_ACK,   "ACK")     \
+    X(OP_ERROR, "ERROR")
+
+// Comandos de texto do feed e do administrador: X(opcode, palavra, domínio, argumentos)
+#define PROTOCOL_COMMANDS(X)                                                                \
+    X(OP_EXIT,     "exit",        DOM_CLIENT, NULL)                                         \
+    X(OP_MSG,      "msg",         DOM_CLIENT, "<topico> <duracao> <mensagem>")              \
+    X(OP_SUB,      "subscribe",   DOM_CLIENT, "<topico> [filtro]")                          \
+    X(OP_UNSUB,    "unsubscribe", DOM_CLIENT, "<topico>")                                   \
+    X(OP_URGENT,   "urgent",      DOM_CLIENT, "<topico> <duracao> <mensagem>")              \
+    X(OP_FILE,     "file",        DOM_CLIENT, "<topico> <ficheiro>")                        \
+    X(OP_LATENCY,  "latency",     DOM_CLIENT, NULL)                                         \
+    X(OP_USERS,    "users",       DOM_ADMIN,  NULL)                                         \
+    X(OP_REMOVE,   "remove",      DOM_ADMIN,  "<username>")                                 \
+    X(OP_TOPICS,   "topics",      DOM_ADMIN,  NULL)                                         \
+    X(OP_SHOW,     "show",        DOM_ADMIN,  "<topico>")                                   \
+    X(OP_LOCK,     "lock",        DOM_ADMIN,  "<topico>")                                   \
+    X(OP_UNLOCK,   "unlock",      DOM_ADMIN,  "<topico>")                                   \
+    X(OP_COMPRESS, "compress",    DOM_ADMIN,  "<topico> <on|off>")                          \
+    X(OP_LIMIT,    "limit",       DOM_ADMIN,  "<user|topic> <nome|*> <taxa/s rajada|off>")  \
+    X(OP_LIMITS,   "limits",      DOM_ADMIN,  NULL)                                         \
+    X(OP_LATENCY,  "latency",     DOM_ADMIN,  "<topico>")                                   \
+    X(OP_THREADS,  "threads",     DOM_ADMIN,  NULL)                                         \
+    X(OP_CLOSE,    "close",       DOM_ADMIN,  NULL)
+
+// Códigos de erro devolvidos nas tramas ERROR: X(código, nome)
+#define PROTOCOL_ERRORS(X)                          \
+    X(ERR_NONE,            "OK")                    \
+    X(ERR_FEED_LIMIT,      "LIMITE_FEEDS")          \
+    X(ERR_TOPIC_LOCKED,    "TOPICO_BLOQUEADO")      \
+    X(ERR_NOT_SUBSCRIBED,  "NAO_SUBSCRITO")         \
+    X(ERR_STREAM_REJECTED, "MENSAGEM_LONGA")        \
+    X(ERR_RATE_USER,       "LIMITE_UTILIZADOR")     \
+    X(ERR_RATE_TOPIC,      "LIMITE_TOPICO")         \
+    X(ERR_OVERLOAD,        "SOBRECARGA")            \
+    X(ERR_BAD_FILTER,      "FILTRO_INVALIDO")
+
+// libfeed.h repete estes dois enums com valores explícitos, para não expor este ficheiro a
+// quem usa a biblioteca; libfeed.c confirma que coincidem. O primeiro a ser incluído define-os.
+#ifndef LIBFEED_TYPES
+#define LIBFEED_TYPES
+#define PROTOCOL_ERROR_ENUM(code, name) code,
+typedef enum {
+    PROTOCOL_ERRORS(PROTOCOL_ERROR_ENUM)
+    ERR_COUNT
+} ErrorCode;
+#undef PROTOCOL_ERROR_ENUM
+
+#define PROTOCOL_ENUM(op) op,
+typedef enum {
+    OP_UNKNOWN = 0,
+    PROTOCOL_OPCODES(PROTOCOL_ENUM)
+    OP_COUNT
+} Opcode;
+#undef PROTOCOL_ENUM
+#endif
+
+// Resultado da análise de uma linha de comando
+typedef struct {
+    Opcode opcode;
+    const char *verb;  // Palavra reconhecida
+    const char *args;  // Resto da linha, sem espaços iniciais ("" se não houver)
+    const char *usage; // Argumentos obrigatórios (NULL se o comando não leva argumentos)
+} ParsedCommand;
+
+Opcode protocol_decode_action(const char action[ACTION_LEN]);
+void protocol_set_action(Message *msg, Opcode opcode);
+int protocol_parse_command(const char *line, int domain, ParsedCommand *out);
+const char *protocol_command_list(int domain);
+const char *protocol_error_name(ErrorCode code);
+
+void message_set_body(Message *msg, const char *text);
+void message_format_body(Message *msg, const char *fmt, ...);
+Message *message_clone(const Message *msg);
+void message_copy(Message *dst, const Message *src);
+int message_compress(Message *msg);
+int message_decompress(Message *msg);
+
+ssize_t protocol_write_frame(int fd, const Message *msg);
+int protocol_read_frame(int fd, Message *msg);
+
+#endif